@@ -0,0 +1,203 @@
+#include "ECGAdc.h"
+
+#include "ECGCheckpoint.h"
+
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+// xorshift64* multiplier and the scale from 53 random bits to [0, 1).
+const uint64 xorshift_multiplier = 0x2545F4914F6CDD1DULL;
+const float64 unit_interval_scale = 1.0 / 9007199254740992.0; // 2^-53
+
+// Scalar conversion of one sample, shared by the SIMD remainder; rounding
+// matches the SIMD path (round to nearest even). NaN fails every comparison
+// and saturates to min_code, counted as clipped, as in the SIMD path.
+inline int32 quantize_sample(float64 x, float64 min_code, float64 max_code,
+                             uint64 *clipped) {
+  if (!(x >= min_code)) {
+    x = min_code;
+    ++*clipped;
+  } else if (x > max_code) {
+    x = max_code;
+    ++*clipped;
+  }
+  return static_cast<int32>(std::nearbyint(x));
+}
+
+#if defined(__SSE2__)
+inline int32 count_bits(int32 mask) {
+  return (mask & 1) + ((mask >> 1) & 1);
+}
+#endif
+
+// Quantizes one lead column. `dither` may be null.
+template <typename Code>
+void quantize_column(const float64 *in, const float64 *dither,
+                     std::size_t count, float64 scale, float64 offset,
+                     float64 min_code, float64 max_code, Code *out,
+                     uint64 *clipped) {
+  std::size_t i = 0;
+
+#if defined(__SSE2__)
+  const __m128d scale_v = _mm_set1_pd(scale);
+  const __m128d offset_v = _mm_set1_pd(offset);
+  const __m128d min_v = _mm_set1_pd(min_code);
+  const __m128d max_v = _mm_set1_pd(max_code);
+  for (; i + 4U <= count; i += 4U) {
+    __m128d lo = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(in + i), scale_v), offset_v);
+    __m128d hi =
+        _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(in + i + 2U), scale_v), offset_v);
+    if (dither != nullptr) {
+      lo = _mm_add_pd(lo, _mm_loadu_pd(dither + i));
+      hi = _mm_add_pd(hi, _mm_loadu_pd(dither + i + 2U));
+    }
+
+    // "Not >=" is also true for NaN, which max_pd below turns into min_code.
+    const int32 lo_out = _mm_movemask_pd(
+        _mm_or_pd(_mm_cmpnge_pd(lo, min_v), _mm_cmpgt_pd(lo, max_v)));
+    const int32 hi_out = _mm_movemask_pd(
+        _mm_or_pd(_mm_cmpnge_pd(hi, min_v), _mm_cmpgt_pd(hi, max_v)));
+    *clipped += static_cast<uint64>(count_bits(lo_out) + count_bits(hi_out));
+
+    lo = _mm_min_pd(_mm_max_pd(lo, min_v), max_v);
+    hi = _mm_min_pd(_mm_max_pd(hi, min_v), max_v);
+    const __m128i codes =
+        _mm_unpacklo_epi64(_mm_cvtpd_epi32(lo), _mm_cvtpd_epi32(hi));
+
+    if (sizeof(Code) == sizeof(int16)) {
+      _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i),
+                       _mm_packs_epi32(codes, codes));
+    } else {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), codes);
+    }
+  }
+#endif
+
+  for (; i < count; ++i) {
+    float64 x = (in[i] * scale) + offset;
+    if (dither != nullptr) {
+      x += dither[i];
+    }
+    out[i] = static_cast<Code>(quantize_sample(x, min_code, max_code, clipped));
+  }
+}
+} // namespace
+
+void allocate_adc_block(Adc_block *block, std::size_t capacity,
+                        std::size_t lead_count, int32 resolution_bits) {
+  block->start_index = 0U;
+  block->count = 0U;
+  block->capacity = capacity;
+  block->lead_count = lead_count;
+  block->resolution_bits = resolution_bits;
+  block->clipped = 0U;
+  if (adc_uses_int16(resolution_bits)) {
+    block->codes16.assign(capacity * lead_count, 0);
+    block->codes32.clear();
+  } else {
+    block->codes32.assign(capacity * lead_count, 0);
+    block->codes16.clear();
+  }
+}
+
+bool Adc_emulator::configure(const Adc_config &config,
+                             std::size_t lead_count) {
+  if (config.resolution_bits < adc_min_resolution_bits ||
+      config.resolution_bits > adc_max_resolution_bits ||
+      config.lsb_mv <= 0.0 || lead_count == 0U ||
+      (!config.lead_gain.empty() && config.lead_gain.size() != lead_count) ||
+      (!config.lead_offset_mv.empty() &&
+       config.lead_offset_mv.size() != lead_count)) {
+    return false;
+  }
+
+  config_ = config;
+  lead_count_ = lead_count;
+  scale_.assign(lead_count, 0.0);
+  offset_.assign(lead_count, 0.0);
+  for (std::size_t lead = 0; lead < lead_count; ++lead) {
+    const float64 gain = config.lead_gain.empty() ? 1.0 : config.lead_gain[lead];
+    const float64 offset_mv =
+        config.lead_offset_mv.empty() ? 0.0 : config.lead_offset_mv[lead];
+    scale_[lead] = gain / config.lsb_mv;
+    offset_[lead] = offset_mv * scale_[lead];
+  }
+  // A zero seed would lock xorshift at zero.
+  rng_state_ = (config.dither_seed != 0U) ? config.dither_seed : 1U;
+  configured_ = true;
+  return true;
+}
+
+float64 Adc_emulator::next_uniform() {
+  rng_state_ ^= rng_state_ >> 12;
+  rng_state_ ^= rng_state_ << 25;
+  rng_state_ ^= rng_state_ >> 27;
+  return static_cast<float64>((rng_state_ * xorshift_multiplier) >> 11) *
+         unit_interval_scale;
+}
+
+void Adc_emulator::convert(const float64 *leads, std::size_t count,
+                           std::size_t stride, uint64 start_index,
+                           Adc_block *out) {
+  out->start_index = start_index;
+  out->count = 0U;
+  out->clipped = 0U;
+  if (!configured_ || out->lead_count != lead_count_ ||
+      out->resolution_bits != config_.resolution_bits) {
+    return;
+  }
+  if (count > out->capacity) {
+    count = out->capacity;
+  }
+
+  const float64 max_code =
+      static_cast<float64>((1 << (config_.resolution_bits - 1)) - 1);
+  const float64 min_code = -max_code - 1.0;
+
+  if (config_.dither && dither_.size() < count) {
+    dither_.resize(count); // first block only, unless reserved
+  }
+
+  for (std::size_t lead = 0; lead < lead_count_; ++lead) {
+    const float64 *dither = nullptr;
+    if (config_.dither) {
+      for (std::size_t i = 0; i < count; ++i) {
+        dither_[i] = next_uniform() - next_uniform();
+      }
+      dither = dither_.data();
+    }
+
+    const float64 *column = leads + (lead * stride);
+    if (adc_uses_int16(config_.resolution_bits)) {
+      quantize_column(column, dither, count, scale_[lead], offset_[lead],
+                      min_code, max_code,
+                      out->codes16.data() + (lead * out->capacity),
+                      &out->clipped);
+    } else {
+      quantize_column(column, dither, count, scale_[lead], offset_[lead],
+                      min_code, max_code,
+                      out->codes32.data() + (lead * out->capacity),
+                      &out->clipped);
+    }
+  }
+  out->count = count;
+}
+
+void Adc_emulator::reserve(std::size_t count) {
+  if (config_.dither && dither_.size() < count) {
+    dither_.resize(count);
+  }
+}
+
+void Adc_emulator::save_state(Checkpoint_writer *writer) const {
+  writer->write_u64(rng_state_);
+}
+
+bool Adc_emulator::restore_state(Checkpoint_reader *reader) {
+  rng_state_ = reader->read_u64();
+  return reader->ok() && rng_state_ != 0U;
+}
@@ -0,0 +1,99 @@
+#ifndef ECG_ADC_H
+#define ECG_ADC_H
+
+#include "Types.h"
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+class Checkpoint_reader;
+class Checkpoint_writer;
+
+// Rule 151: Avoid magic numbers. Supported converter widths.
+const int32 adc_min_resolution_bits = 8;
+const int32 adc_max_resolution_bits = 24;
+// Converters up to this width deliver int16 codes, wider ones int32.
+const int32 adc_int16_resolution_bits = 16;
+
+struct Adc_config {
+  int32 resolution_bits{16};
+  float64 lsb_mv{0.0025}; // 2.5 uV per code
+  // Per-lead analog gain and offset (mV, applied before gain). Empty means
+  // gain 1 and offset 0 for every lead; otherwise one entry per lead.
+  std::vector<float64> lead_gain;
+  std::vector<float64> lead_offset_mv;
+  // Triangular (TPDF) dither of +/-1 LSB from a seeded generator.
+  bool dither{false};
+  uint64 dither_seed{1U};
+};
+
+// Quantized output of one Sample_block, lead-major like the block it came
+// from. Only one of the code buffers is used, depending on the resolution.
+struct Adc_block {
+  Adc_block() = default;
+  // Codes are allocated from `resource` (e.g. an Ecg_arena).
+  explicit Adc_block(std::pmr::memory_resource *resource)
+      : codes16(resource), codes32(resource) {}
+
+  uint64 start_index{0U};
+  std::size_t count{0U};
+  std::size_t capacity{0U};
+  std::size_t lead_count{0U};
+  int32 resolution_bits{0};
+  std::pmr::vector<int16> codes16;
+  std::pmr::vector<int32> codes32;
+  uint64 clipped{0U}; // samples that saturated in this block
+};
+
+void allocate_adc_block(Adc_block *block, std::size_t capacity,
+                        std::size_t lead_count, int32 resolution_bits);
+
+inline bool adc_uses_int16(int32 resolution_bits) {
+  return resolution_bits <= adc_int16_resolution_bits;
+}
+
+/**
+ * @brief Emulates a multi-channel ECG front end: gain, offset, optional
+ * dither, rounding to the nearest code and saturation at full scale.
+ *
+ * Conversion runs per lead column with SSE2 when available: clamp in
+ * floating point, convert with round-to-nearest, then pack with signed
+ * saturation for 16-bit output.
+ */
+class Adc_emulator {
+public:
+  Adc_emulator() = default;
+
+  // Returns false (and stays unconfigured) for an unsupported resolution,
+  // a non-positive LSB, or per-lead vectors of the wrong length.
+  bool configure(const Adc_config &config, std::size_t lead_count);
+  bool is_configured() const { return configured_; }
+  const Adc_config &config() const { return config_; }
+
+  // Quantize `count` samples of `lead_count` lead columns (column stride
+  // `stride`) into `out`, which must be allocated for this emulator.
+  void convert(const float64 *leads, std::size_t count, std::size_t stride,
+               uint64 start_index, Adc_block *out);
+
+  // Size the dither scratch for blocks of up to `count` samples; otherwise
+  // it grows on the first convert().
+  void reserve(std::size_t count);
+
+  // Dither generator state, for engine checkpoints.
+  void save_state(Checkpoint_writer *writer) const;
+  bool restore_state(Checkpoint_reader *reader);
+
+private:
+  float64 next_uniform();
+
+  Adc_config config_;
+  bool configured_{false};
+  std::size_t lead_count_{0U};
+  std::vector<float64> scale_;  // gain / lsb per lead
+  std::vector<float64> offset_; // offset * gain / lsb per lead, in codes
+  std::vector<float64> dither_; // scratch, one block of dither values
+  uint64 rng_state_{1U};
+};
+
+#endif // ECG_ADC_H
@@ -0,0 +1,179 @@
+// Tests of the arena-backed mode (ecg_allocation_tests): once an engine, its
+// noise sources and its blocks have been set up in an Ecg_arena, generating
+// must not touch the heap. This executable replaces the global operator new
+// to count heap allocations.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "ECGArena.h"
+#include "ECGSimulation.h"
+#include "ECGSpectralNoise.h"
+#include "NoiseGenerator.h"
+
+namespace
+{
+std::atomic<uint64> heap_allocations{0U};
+
+void *counted_allocate(std::size_t size)
+{
+    heap_allocations.fetch_add(1U, std::memory_order_relaxed);
+    void *memory = std::malloc((size == 0U) ? 1U : size);
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void *counted_allocate_aligned(std::size_t size, std::align_val_t alignment)
+{
+    heap_allocations.fetch_add(1U, std::memory_order_relaxed);
+    const std::size_t align = static_cast<std::size_t>(alignment);
+    void *memory = std::aligned_alloc(align, ((size + align - 1U) / align) * align);
+    if (memory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+} // namespace
+
+void *operator new(std::size_t size) { return counted_allocate(size); }
+void *operator new[](std::size_t size) { return counted_allocate(size); }
+void *operator new(std::size_t size, std::align_val_t alignment) { return counted_allocate_aligned(size, alignment); }
+void *operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return counted_allocate_aligned(size, alignment);
+}
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete[](void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void *memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void *memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+
+namespace
+{
+const std::size_t block_samples = 256U;
+const float64 sampling_rate_hz = 500.0;
+
+struct Destruction_counter
+{
+    explicit Destruction_counter(int32 *count) : count_(count) {}
+    ~Destruction_counter() { ++*count_; }
+    int32 *count_;
+};
+} // namespace
+
+TEST(Allocation, ArenaEngineGeneratesWithoutHeapAllocation)
+{
+    std::vector<unsigned char> storage(4U << 20U);
+    Ecg_arena arena(storage.data(), storage.size());
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+
+    // Setup: everything comes from the arena (the spectral generator's FFT
+    // tables and filter are still built on the heap here, once).
+    ECGSimulationEngine *engine = arena.create<ECGSimulationEngine>(morphology, 72.0, sampling_rate_hz, &arena);
+    CompositeGenerator *interference = arena.create<CompositeGenerator>(&arena);
+    interference->add(arena.create<BaselineWanderGenerator>(0.1));
+    interference->add(arena.create<MainsHumGenerator>(0.02, 50.0));
+    engine->add_noise_source(arena.create<WhiteNoiseGenerator>(0.05, 42U));
+    engine->add_noise_source(interference);
+    engine->add_noise_source(
+        arena.create<SpectralNoiseGenerator>(create_colored_noise_config(1.0, 0.02), sampling_rate_hz));
+    Adc_config adc;
+    adc.resolution_bits = 24;
+    adc.dither = true;
+    ASSERT_TRUE(engine->set_adc(adc));
+
+    Sample_block *block = arena.create<Sample_block>(&arena);
+    allocate_sample_block(block, block_samples, engine->lead_count());
+    allocate_adc_block(&block->adc, block_samples, engine->lead_count(), adc.resolution_bits);
+    engine->reserve_blocks(block_samples);
+
+    // Random access needs sources with has_random_access().
+    ECGSimulationEngine *sampler = arena.create<ECGSimulationEngine>(morphology, 72.0, sampling_rate_hz, &arena);
+    sampler->add_noise_source(interference);
+    const std::size_t query_count = 1000U;
+    sampler->reserve_evaluate(query_count);
+    float64 *times = arena.create_array<float64>(query_count);
+    float64 *leads = arena.create_array<float64>(query_count * standard_lead_count);
+    for (std::size_t i = 0; i < query_count; ++i)
+    {
+        times[i] = 0.0021 * static_cast<float64>((i * 613U) % query_count);
+    }
+
+    const std::size_t record_capacity = static_cast<std::size_t>(engine->sample_count(0.5));
+    Lead_sample *record = arena.create_array<Lead_sample>(record_capacity);
+
+    // Steady state.
+    const uint64 before = heap_allocations.load();
+    for (int32 i = 0; i < 200; ++i)
+    {
+        ASSERT_EQ(engine->generate_block(block, block_samples), block_samples);
+        ASSERT_TRUE(sampler->evaluate(times, query_count, leads, query_count));
+        ASSERT_EQ(engine->generate(0.5, record, record_capacity), record_capacity);
+    }
+    EXPECT_EQ(heap_allocations.load() - before, 0U);
+    EXPECT_EQ(arena.upstream_allocations(), 0U);
+    EXPECT_EQ(engine->next_sample_index(), 200U * block_samples);
+}
+
+TEST(Allocation, ArenaMatchesHeapEngine)
+{
+    std::vector<unsigned char> storage(1U << 20U);
+    Ecg_arena arena(storage.data(), storage.size());
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+
+    ECGSimulationEngine heap(morphology, 72.0, sampling_rate_hz);
+    heap.add_noise_source(std::make_shared<WhiteNoiseGenerator>(0.05, 42U));
+    ECGSimulationEngine *pooled = arena.create<ECGSimulationEngine>(morphology, 72.0, sampling_rate_hz, &arena);
+    pooled->add_noise_source(arena.create<WhiteNoiseGenerator>(0.05, 42U));
+
+    Sample_block expected{};
+    allocate_sample_block(&expected, block_samples, standard_lead_count);
+    Sample_block *block = arena.create<Sample_block>(&arena);
+    allocate_sample_block(block, block_samples, standard_lead_count);
+    for (int32 i = 0; i < 4; ++i)
+    {
+        heap.generate_block(&expected, block_samples);
+        pooled->generate_block(block, block_samples);
+        EXPECT_TRUE(expected.values == block->values);
+    }
+
+    const std::vector<Lead_sample> samples = heap.generate(1.0);
+    Lead_sample *record = arena.create_array<Lead_sample>(samples.size());
+    ASSERT_EQ(pooled->generate(1.0, record, samples.size()), samples.size());
+    EXPECT_EQ(record[samples.size() - 1U].leads[lead_ii_index], samples.back().leads[lead_ii_index]);
+}
+
+TEST(Allocation, ArenaOverflowsUpstreamAndReleases)
+{
+    // Deliberately misaligned and too small for a block.
+    std::vector<unsigned char> storage(257U);
+    Ecg_arena arena(storage.data() + 1, storage.size() - 1U);
+
+    int32 destroyed = 0;
+    arena.create<Destruction_counter>(&destroyed);
+    Sample_block *block = arena.create<Sample_block>(&arena);
+    allocate_sample_block(block, block_samples, standard_lead_count);
+    EXPECT_GT(arena.upstream_allocations(), 0U);
+    EXPECT_LE(arena.used(), arena.capacity());
+    for (const float64 *column : {block->values.data(), block->time_s.data()})
+    {
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(column) % alignof(float64), 0U);
+    }
+
+    arena.release();
+    EXPECT_EQ(destroyed, 1);
+    EXPECT_EQ(arena.used(), 0U);
+    EXPECT_EQ(arena.upstream_allocations(), 0U);
+}
@@ -0,0 +1,473 @@
+#include "ECGArchive.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const char archive_header_magic[8] = {'E', 'C', 'G', 'A', 'R', 'C', 'H', '1'};
+const char archive_trailer_magic[8] = {'E', 'C', 'G', 'A', 'I', 'D', 'X', '1'};
+} // namespace
+
+// --- Archive_writer ---
+
+Archive_writer::~Archive_writer() {
+  if (is_open_) {
+    close();
+  }
+}
+
+bool Archive_writer::open(const std::string &path, std::size_t lead_count,
+                          float64 sampling_rate_hz, std::size_t chunk_samples,
+                          bool with_stats) {
+  if (is_open_ || lead_count == 0U || chunk_samples == 0U ||
+      !std::isfinite(sampling_rate_hz) || sampling_rate_hz <= 0.0) {
+    return false;
+  }
+
+  file_.open(path, std::ios::binary | std::ios::trunc);
+  if (!file_.is_open()) {
+    return false;
+  }
+
+  std::memcpy(header_.magic, archive_header_magic, sizeof(header_.magic));
+  header_.version = archive_version;
+  header_.lead_count = static_cast<uint32>(lead_count);
+  header_.sampling_rate_hz = sampling_rate_hz;
+  header_.chunk_samples = chunk_samples;
+  header_.flags = with_stats ? archive_flag_stats : 0U;
+  header_.reserved = 0U;
+
+  file_.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+  offset_ = sizeof(header_);
+
+  chunk_.assign(chunk_samples * lead_count, 0.0);
+  chunk_fill_ = 0U;
+  entries_.clear();
+  stats_.clear();
+  is_open_ = true;
+  next_index_ = 0U;
+  chunk_start_index_ = 0U;
+  return file_.good();
+}
+
+bool Archive_writer::append(const Sample_block *block) {
+  if (!is_open_ || block->lead_count != header_.lead_count) {
+    return false;
+  }
+  if (entries_.empty() && chunk_fill_ == 0U && next_index_ == 0U) {
+    // The first block fixes where the record starts (a resumed run need not
+    // start at sample 0).
+    next_index_ = block->start_index;
+    chunk_start_index_ = block->start_index;
+  }
+  if (block->start_index != next_index_) {
+    return false;
+  }
+
+  const std::size_t chunk_samples =
+      static_cast<std::size_t>(header_.chunk_samples);
+  std::size_t done = 0U;
+  while (done < block->count) {
+    const std::size_t n =
+        std::min(block->count - done, chunk_samples - chunk_fill_);
+    for (std::size_t lead = 0; lead < block->lead_count; ++lead) {
+      std::memcpy(chunk_.data() + (lead * chunk_samples) + chunk_fill_,
+                  lead_column(block, lead) + done, n * sizeof(float64));
+    }
+    chunk_fill_ += n;
+    done += n;
+    if (chunk_fill_ == chunk_samples && !flush_chunk()) {
+      return false;
+    }
+  }
+  next_index_ += block->count;
+  return true;
+}
+
+bool Archive_writer::flush_chunk() {
+  if (chunk_fill_ == 0U) {
+    return true;
+  }
+
+  const std::size_t chunk_samples =
+      static_cast<std::size_t>(header_.chunk_samples);
+  Archive_chunk_entry entry;
+  entry.start_index = chunk_start_index_;
+  entry.sample_count = chunk_fill_;
+  entry.offset = offset_;
+  entries_.push_back(entry);
+
+  for (std::size_t lead = 0; lead < header_.lead_count; ++lead) {
+    const float64 *column = chunk_.data() + (lead * chunk_samples);
+    if ((header_.flags & archive_flag_stats) != 0U) {
+      const auto range = std::minmax_element(column, column + chunk_fill_);
+      stats_.push_back({*range.first, *range.second});
+    }
+    file_.write(reinterpret_cast<const char *>(column),
+                static_cast<std::streamsize>(chunk_fill_ * sizeof(float64)));
+  }
+
+  offset_ += static_cast<uint64>(chunk_fill_) * header_.lead_count *
+             sizeof(float64);
+  chunk_start_index_ += chunk_fill_;
+  chunk_fill_ = 0U;
+  return file_.good();
+}
+
+bool Archive_writer::close() {
+  if (!is_open_) {
+    return false;
+  }
+  is_open_ = false;
+
+  bool ok = flush_chunk();
+
+  Archive_trailer trailer;
+  trailer.footer_offset = offset_;
+  trailer.chunk_count = entries_.size();
+  trailer.total_samples = 0U;
+  for (std::size_t i = 0; i < entries_.size(); ++i) {
+    trailer.total_samples += entries_[i].sample_count;
+    file_.write(reinterpret_cast<const char *>(&entries_[i]),
+                sizeof(Archive_chunk_entry));
+    if ((header_.flags & archive_flag_stats) != 0U) {
+      file_.write(reinterpret_cast<const char *>(
+                      &stats_[i * header_.lead_count]),
+                  static_cast<std::streamsize>(header_.lead_count *
+                                               sizeof(Archive_lead_stats)));
+    }
+  }
+  std::memcpy(trailer.magic, archive_trailer_magic, sizeof(trailer.magic));
+  file_.write(reinterpret_cast<const char *>(&trailer), sizeof(trailer));
+
+  ok = ok && file_.good();
+  file_.close();
+  return ok && !file_.fail();
+}
+
+bool Archive_writer::save_state(Checkpoint_writer *writer) {
+  if (!is_open_) {
+    return false;
+  }
+  file_.flush();
+
+  writer->write_bytes(&header_, sizeof(header_));
+  writer->write_u64(offset_);
+  writer->write_u64(next_index_);
+  writer->write_u64(chunk_start_index_);
+  writer->write_u64(chunk_fill_);
+  const std::size_t chunk_samples =
+      static_cast<std::size_t>(header_.chunk_samples);
+  for (std::size_t lead = 0; lead < header_.lead_count; ++lead) {
+    writer->write_bytes(chunk_.data() + (lead * chunk_samples),
+                        chunk_fill_ * sizeof(float64));
+  }
+  writer->write_u64(entries_.size());
+  writer->write_bytes(entries_.data(),
+                      entries_.size() * sizeof(Archive_chunk_entry));
+  writer->write_u64(stats_.size());
+  writer->write_bytes(stats_.data(),
+                      stats_.size() * sizeof(Archive_lead_stats));
+  return file_.good();
+}
+
+bool Archive_writer::resume(const std::string &path,
+                            Checkpoint_reader *reader) {
+  if (is_open_) {
+    return false;
+  }
+
+  Archive_header header;
+  reader->read_bytes(&header, sizeof(header));
+  const uint64 offset = reader->read_u64();
+  const uint64 next_index = reader->read_u64();
+  const uint64 chunk_start_index = reader->read_u64();
+  const uint64 chunk_fill = reader->read_u64();
+  if (!reader->ok() ||
+      std::memcmp(header.magic, archive_header_magic, sizeof(header.magic)) !=
+          0 ||
+      header.lead_count == 0U || chunk_fill >= header.chunk_samples) {
+    return false;
+  }
+
+  const std::size_t chunk_samples =
+      static_cast<std::size_t>(header.chunk_samples);
+  chunk_.assign(chunk_samples * header.lead_count, 0.0);
+  for (std::size_t lead = 0; lead < header.lead_count; ++lead) {
+    reader->read_bytes(chunk_.data() + (lead * chunk_samples),
+                       static_cast<std::size_t>(chunk_fill) * sizeof(float64));
+  }
+
+  const uint64 entry_count = reader->read_u64();
+  if (!reader->ok() ||
+      entry_count > reader->remaining() / sizeof(Archive_chunk_entry)) {
+    return false;
+  }
+  entries_.resize(static_cast<std::size_t>(entry_count));
+  reader->read_bytes(entries_.data(),
+                     entries_.size() * sizeof(Archive_chunk_entry));
+
+  const uint64 stats_count = reader->read_u64();
+  if (!reader->ok() ||
+      stats_count > reader->remaining() / sizeof(Archive_lead_stats)) {
+    return false;
+  }
+  stats_.resize(static_cast<std::size_t>(stats_count));
+  reader->read_bytes(stats_.data(), stats_.size() * sizeof(Archive_lead_stats));
+  if (!reader->ok()) {
+    return false;
+  }
+
+  // Drop whatever the interrupted run wrote after the checkpoint.
+  if (::truncate(path.c_str(), static_cast<off_t>(offset)) != 0) {
+    return false;
+  }
+  file_.open(path, std::ios::binary | std::ios::in | std::ios::out);
+  if (!file_.is_open()) {
+    return false;
+  }
+  file_.seekp(static_cast<std::streamoff>(offset));
+
+  header_ = header;
+  offset_ = offset;
+  next_index_ = next_index;
+  chunk_start_index_ = chunk_start_index;
+  chunk_fill_ = static_cast<std::size_t>(chunk_fill);
+  is_open_ = true;
+  return file_.good();
+}
+
+// --- Archive_reader ---
+
+Archive_reader::~Archive_reader() { close(); }
+
+bool Archive_reader::open(const std::string &path) {
+  close();
+
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info;
+  if (::fstat(fd, &info) != 0 ||
+      static_cast<std::size_t>(info.st_size) <
+          sizeof(Archive_header) + sizeof(Archive_trailer)) {
+    ::close(fd);
+    return false;
+  }
+
+  const std::size_t size = static_cast<std::size_t>(info.st_size);
+  void *map = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  data_ = static_cast<const uint8 *>(map);
+  size_ = size;
+
+  Archive_trailer trailer;
+  std::memcpy(&header_, data_, sizeof(header_));
+  std::memcpy(&trailer, data_ + size_ - sizeof(trailer), sizeof(trailer));
+
+  entry_stride_ = sizeof(Archive_chunk_entry);
+  if ((header_.flags & archive_flag_stats) != 0U) {
+    entry_stride_ += header_.lead_count * sizeof(Archive_lead_stats);
+  }
+
+  // The footer must fill the file between the chunk data and the trailer.
+  // Compared by division, so a corrupt chunk count cannot overflow.
+  const uint64 footer_end = size_ - sizeof(trailer);
+  const bool valid =
+      std::memcmp(header_.magic, archive_header_magic, sizeof(header_.magic)) ==
+          0 &&
+      std::memcmp(trailer.magic, archive_trailer_magic,
+                  sizeof(trailer.magic)) == 0 &&
+      header_.version == archive_version && header_.lead_count > 0U &&
+      header_.chunk_samples > 0U && std::isfinite(header_.sampling_rate_hz) &&
+      header_.sampling_rate_hz > 0.0 &&
+      trailer.footer_offset >= sizeof(Archive_header) &&
+      trailer.footer_offset <= footer_end &&
+      (trailer.footer_offset % alignof(Archive_chunk_entry)) == 0U &&
+      ((footer_end - trailer.footer_offset) % entry_stride_) == 0U &&
+      ((footer_end - trailer.footer_offset) / entry_stride_) ==
+          trailer.chunk_count;
+  if (!valid) {
+    close();
+    return false;
+  }
+
+  footer_ = data_ + trailer.footer_offset;
+  chunk_count_ = static_cast<std::size_t>(trailer.chunk_count);
+  total_samples_ = trailer.total_samples;
+  if (!chunks_valid(trailer.footer_offset)) {
+    close();
+    return false;
+  }
+
+  // The footer is the only part read up front; hint that chunk data will be
+  // accessed sparsely.
+  ::madvise(const_cast<uint8 *>(data_), size_, MADV_RANDOM);
+  return true;
+}
+
+void Archive_reader::close() {
+  if (data_ != nullptr) {
+    ::munmap(const_cast<uint8 *>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0U;
+  footer_ = nullptr;
+  chunk_count_ = 0U;
+  total_samples_ = 0U;
+}
+
+bool Archive_reader::chunks_valid(uint64 footer_offset) const {
+  // read() copies straight from the offsets in the footer, so every entry
+  // must lie between the header and the footer, hold at most one chunk and
+  // follow the previous one; together they must make up the record.
+  const uint64 sample_bytes =
+      static_cast<uint64>(header_.lead_count) * sizeof(float64);
+  uint64 next_index = (chunk_count_ > 0U) ? chunk(0U).start_index : 0U;
+  for (std::size_t c = 0; c < chunk_count_; ++c) {
+    const Archive_chunk_entry &entry = chunk(c);
+    if (entry.start_index != next_index || entry.sample_count == 0U ||
+        entry.sample_count > header_.chunk_samples ||
+        entry.offset < sizeof(Archive_header) ||
+        entry.offset > footer_offset ||
+        entry.sample_count > (footer_offset - entry.offset) / sample_bytes ||
+        entry.sample_count >
+            std::numeric_limits<uint64>::max() - entry.start_index) {
+      return false;
+    }
+    next_index = entry.start_index + entry.sample_count;
+  }
+  return (chunk_count_ == 0U) ||
+         (next_index - chunk(0U).start_index == total_samples_);
+}
+
+const uint8 *Archive_reader::entry_address(std::size_t index) const {
+  return footer_ + (index * entry_stride_);
+}
+
+const Archive_chunk_entry &Archive_reader::chunk(std::size_t index) const {
+  return *reinterpret_cast<const Archive_chunk_entry *>(entry_address(index));
+}
+
+const Archive_lead_stats *Archive_reader::chunk_stats(std::size_t index,
+                                                      std::size_t lead) const {
+  if (!has_stats() || index >= chunk_count_ || lead >= header_.lead_count) {
+    return nullptr;
+  }
+  return reinterpret_cast<const Archive_lead_stats *>(
+             entry_address(index) + sizeof(Archive_chunk_entry)) +
+         lead;
+}
+
+std::size_t Archive_reader::find_chunk(uint64 sample_index) const {
+  // Last chunk whose start_index <= sample_index.
+  std::size_t lo = 0U;
+  std::size_t hi = chunk_count_;
+  while (hi - lo > 1U) {
+    const std::size_t mid = lo + ((hi - lo) / 2U);
+    if (chunk(mid).start_index <= sample_index) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+bool Archive_reader::read(uint64 first_index, uint64 count,
+                          const std::vector<std::size_t> &leads,
+                          Archive_window *out) const {
+  out->start_index = first_index;
+  out->count = 0U;
+  out->time_s.clear();
+  out->values.clear();
+
+  for (const std::size_t lead : leads) {
+    if (lead >= header_.lead_count) {
+      return false;
+    }
+  }
+  if (chunk_count_ == 0U) {
+    return true;
+  }
+
+  const uint64 record_begin = chunk(0U).start_index;
+  const uint64 record_end = record_begin + total_samples_;
+  if (first_index >= record_end) {
+    return true;
+  }
+  // Saturating first_index + count: a huge count must not wrap around.
+  const uint64 begin = std::max(first_index, record_begin);
+  const uint64 end = (count > record_end - first_index) ? record_end
+                                                        : first_index + count;
+  if (begin >= end) {
+    return true;
+  }
+
+  const std::size_t n = static_cast<std::size_t>(end - begin);
+  out->start_index = begin;
+  out->count = n;
+  out->time_s.resize(n);
+  out->values.resize(n * leads.size());
+
+  const float64 dt = 1.0 / header_.sampling_rate_hz;
+  for (std::size_t i = 0; i < n; ++i) {
+    out->time_s[i] = static_cast<float64>(begin + i) * dt;
+  }
+
+  for (std::size_t c = find_chunk(begin); c < chunk_count_; ++c) {
+    const Archive_chunk_entry &entry = chunk(c);
+    if (entry.start_index >= end) {
+      break;
+    }
+    const uint64 from = std::max(begin, entry.start_index);
+    const uint64 to = std::min(end, entry.start_index + entry.sample_count);
+    const std::size_t span = static_cast<std::size_t>(to - from);
+    for (std::size_t k = 0; k < leads.size(); ++k) {
+      const uint8 *column =
+          data_ + entry.offset +
+          (leads[k] * entry.sample_count * sizeof(float64));
+      std::memcpy(out->values.data() + (k * n) + (from - begin),
+                  column + ((from - entry.start_index) * sizeof(float64)),
+                  span * sizeof(float64));
+    }
+  }
+  return true;
+}
+
+bool Archive_reader::read_window(float64 start_s, float64 end_s,
+                                 const std::vector<std::size_t> &leads,
+                                 Archive_window *out) const {
+  if (!std::isfinite(start_s) || !std::isfinite(end_s)) {
+    out->start_index = 0U;
+    out->count = 0U;
+    out->time_s.clear();
+    out->values.clear();
+    return false;
+  }
+  // Clamp in floating point before converting: a time far past the record
+  // would not fit in a uint64.
+  const float64 fs = header_.sampling_rate_hz;
+  const float64 record_end = static_cast<float64>(
+      ((chunk_count_ > 0U) ? chunk(0U).start_index : 0U) + total_samples_);
+  const float64 first =
+      std::min(std::ceil(std::max(start_s, 0.0) * fs), record_end);
+  const float64 last =
+      std::min(std::ceil(std::max(end_s, 0.0) * fs), record_end);
+  const uint64 first_index = static_cast<uint64>(first);
+  const uint64 end_index = static_cast<uint64>(last);
+  return read(first_index, (end_index > first_index) ? end_index - first_index
+                                                     : 0U,
+              leads, out);
+}
@@ -0,0 +1,172 @@
+#ifndef ECG_ARCHIVE_H
+#define ECG_ARCHIVE_H
+
+#include "ECGCheckpoint.h"
+#include "ECGSimulation.h"
+#include "Types.h"
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * Chunked columnar archive for long simulated records.
+ *
+ * Layout (native byte order, all sections 8-byte aligned):
+ *
+ *   Archive_header
+ *   chunk 0: lead 0 column, lead 1 column, ... (float64 x sample_count each)
+ *   chunk 1: ...
+ *   footer:  one Archive_chunk_entry per chunk, each followed by lead_count
+ *            Archive_lead_stats when the archive carries stats
+ *   Archive_trailer
+ *
+ * Sample times are not stored; sample i is at i / sampling_rate_hz, the same
+ * grid the engine renders. The footer maps sample ranges to file offsets so a
+ * reader can fetch any window by touching only the chunks that overlap it.
+ */
+
+struct Archive_header {
+  char magic[8];
+  uint32 version;
+  uint32 lead_count;
+  float64 sampling_rate_hz;
+  uint64 chunk_samples;
+  uint32 flags;
+  uint32 reserved;
+};
+
+struct Archive_chunk_entry {
+  uint64 start_index;
+  uint64 sample_count;
+  uint64 offset; // file offset of the chunk's lead 0 column
+};
+
+struct Archive_lead_stats {
+  float64 min;
+  float64 max;
+};
+
+struct Archive_trailer {
+  uint64 footer_offset;
+  uint64 chunk_count;
+  uint64 total_samples;
+  char magic[8];
+};
+
+const uint32 archive_version = 1U;
+const uint32 archive_flag_stats = 1U;
+
+/**
+ * @brief Streams engine blocks into an archive file.
+ *
+ * Incoming blocks may have any size; samples are regrouped into chunks of
+ * exactly `chunk_samples` (the last chunk may be shorter).
+ */
+class Archive_writer {
+public:
+  Archive_writer() = default;
+  ~Archive_writer();
+
+  Archive_writer(const Archive_writer &) = delete;
+  Archive_writer &operator=(const Archive_writer &) = delete;
+
+  bool open(const std::string &path, std::size_t lead_count,
+            float64 sampling_rate_hz, std::size_t chunk_samples,
+            bool with_stats);
+
+  // Append the valid samples of `block`. Blocks must be consecutive.
+  bool append(const Sample_block *block);
+
+  // Flush the partial chunk and write the footer. Returns false on I/O error.
+  bool close();
+
+  // Flush written chunks to the file and record the writer's position,
+  // index and partial chunk so resume() can continue the same file.
+  bool save_state(Checkpoint_writer *writer);
+
+  // Reopen `path` as saved by save_state(): anything written after the
+  // checkpoint is truncated away and appending continues from there.
+  bool resume(const std::string &path, Checkpoint_reader *reader);
+
+private:
+  bool flush_chunk();
+
+  std::ofstream file_;
+  Archive_header header_{};
+  std::vector<float64> chunk_; // lead-major, chunk_samples per lead
+  std::size_t chunk_fill_{0U};
+  uint64 chunk_start_index_{0U};
+  uint64 next_index_{0U};
+  uint64 offset_{0U};
+  std::vector<Archive_chunk_entry> entries_;
+  std::vector<Archive_lead_stats> stats_; // lead_count per entry
+  bool is_open_{false};
+};
+
+// A window of samples for a subset of leads.
+struct Archive_window {
+  uint64 start_index{0U};
+  std::size_t count{0U};
+  std::vector<float64> time_s;
+  std::vector<float64> values; // one column of `count` per requested lead
+};
+
+/**
+ * @brief Memory-mapped, random-access reader for archive files.
+ *
+ * Opening maps the file and validates the footer, including every chunk
+ * entry, and rejects the file if any is inconsistent; reads copy only from the
+ * chunks that overlap the requested range, so the kernel pages in nothing
+ * else.
+ */
+class Archive_reader {
+public:
+  Archive_reader() = default;
+  ~Archive_reader();
+
+  Archive_reader(const Archive_reader &) = delete;
+  Archive_reader &operator=(const Archive_reader &) = delete;
+
+  bool open(const std::string &path);
+  void close();
+
+  std::size_t lead_count() const { return header_.lead_count; }
+  float64 sampling_rate_hz() const { return header_.sampling_rate_hz; }
+  uint64 total_samples() const { return total_samples_; }
+  std::size_t chunk_count() const { return chunk_count_; }
+  bool has_stats() const { return (header_.flags & archive_flag_stats) != 0U; }
+
+  const Archive_chunk_entry &chunk(std::size_t index) const;
+
+  // Per-chunk min/max of a lead; nullptr when the archive has no stats.
+  const Archive_lead_stats *chunk_stats(std::size_t index,
+                                        std::size_t lead) const;
+
+  // Read samples [first_index, first_index + count) of the given leads.
+  // The range is clipped to the record. Returns false on a bad lead index.
+  bool read(uint64 first_index, uint64 count, const std::vector<std::size_t> &leads,
+            Archive_window *out) const;
+
+  // Read every sample with start_s <= t < end_s. Returns false on a bad lead
+  // index or a non-finite time.
+  bool read_window(float64 start_s, float64 end_s,
+                   const std::vector<std::size_t> &leads,
+                   Archive_window *out) const;
+
+private:
+  bool chunks_valid(uint64 footer_offset) const;
+  std::size_t find_chunk(uint64 sample_index) const;
+  const uint8 *entry_address(std::size_t index) const;
+
+  const uint8 *data_{nullptr};
+  std::size_t size_{0U};
+  Archive_header header_{};
+  std::size_t chunk_count_{0U};
+  uint64 total_samples_{0U};
+  const uint8 *footer_{nullptr};
+  std::size_t entry_stride_{0U};
+};
+
+#endif // ECG_ARCHIVE_H
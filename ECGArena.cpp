@@ -0,0 +1,52 @@
+#include "ECGArena.h"
+
+#include <cstdint>
+
+namespace {
+std::size_t round_up(std::size_t value, std::size_t alignment) {
+  return (value + alignment - 1U) & ~(alignment - 1U);
+}
+} // namespace
+
+Ecg_arena::Ecg_arena(void *buffer, std::size_t size,
+                     std::pmr::memory_resource *upstream)
+    : buffer_(static_cast<unsigned char *>(buffer)), size_(size),
+      upstream_(upstream) {}
+
+Ecg_arena::~Ecg_arena() { release(); }
+
+void Ecg_arena::release() {
+  while (destructors_ != nullptr) {
+    Destructor *record = destructors_;
+    destructors_ = record->next;
+    record->destroy(record->object);
+  }
+  while (upstream_blocks_ != nullptr) {
+    Upstream_block *block = upstream_blocks_;
+    upstream_blocks_ = block->next;
+    upstream_->deallocate(block, block->bytes, block->alignment);
+  }
+  used_ = 0U;
+  upstream_allocations_ = 0U;
+}
+
+void *Ecg_arena::do_allocate(std::size_t bytes, std::size_t alignment) {
+  // Align the address, not the offset: the buffer itself may be unaligned.
+  const std::uintptr_t base = reinterpret_cast<std::uintptr_t>(buffer_);
+  const std::size_t start =
+      static_cast<std::size_t>(round_up(base + used_, alignment) - base);
+  if (start <= size_ && bytes <= size_ - start) {
+    used_ = start + bytes;
+    return buffer_ + start;
+  }
+
+  const std::size_t block_alignment =
+      (alignment > alignof(Upstream_block)) ? alignment
+                                            : alignof(Upstream_block);
+  const std::size_t header = round_up(sizeof(Upstream_block), block_alignment);
+  void *memory = upstream_->allocate(header + bytes, block_alignment);
+  upstream_blocks_ = new (memory)
+      Upstream_block{upstream_blocks_, header + bytes, block_alignment};
+  ++upstream_allocations_;
+  return static_cast<unsigned char *>(memory) + header;
+}
@@ -0,0 +1,99 @@
+#ifndef ECG_ARENA_H
+#define ECG_ARENA_H
+
+#include "Types.h"
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Bump allocator over a caller-provided buffer, so that an engine,
+ * its noise sources and its blocks can be set up once and then run without
+ * touching the heap.
+ *
+ * Objects made with create() and containers given the arena as their
+ * std::pmr::memory_resource (ECGSimulationEngine, Sample_block,
+ * CompositeGenerator) take their memory from the buffer. Deallocation is a
+ * no-op: memory is reclaimed by release() or the destructor, which first
+ * destroy the objects made with create() in reverse order. Requests that do
+ * not fit in the buffer are passed to the upstream resource (the heap by
+ * default) and counted, so a caller can check that the buffer was big
+ * enough.
+ */
+class Ecg_arena : public std::pmr::memory_resource {
+public:
+  Ecg_arena(void *buffer, std::size_t size,
+            std::pmr::memory_resource *upstream =
+                std::pmr::new_delete_resource());
+  ~Ecg_arena() override;
+
+  Ecg_arena(const Ecg_arena &) = delete;
+  Ecg_arena &operator=(const Ecg_arena &) = delete;
+
+  // Construct a T in the arena. It is destroyed by release().
+  template <typename T, typename... Args> T *create(Args &&...args) {
+    void *memory = allocate(sizeof(T), alignof(T));
+    T *object = new (memory) T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value) {
+      void *slot = allocate(sizeof(Destructor), alignof(Destructor));
+      destructors_ = new (slot) Destructor{&destroy<T>, object, destructors_};
+    }
+    return object;
+  }
+
+  // Value-initialized array of a trivially destructible type, e.g. an
+  // output buffer for ECGSimulationEngine::generate().
+  template <typename T> T *create_array(std::size_t count) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "arrays are never destroyed");
+    void *memory = allocate(count * sizeof(T), alignof(T));
+    return new (memory) T[count]();
+  }
+
+  // Destroy everything made with create() and reuse the buffer from the
+  // start. Nothing allocated from the arena may be used afterwards.
+  void release();
+
+  std::size_t capacity() const { return size_; }
+  std::size_t used() const { return used_; }
+  // Requests served by the upstream resource since the last release().
+  uint64 upstream_allocations() const { return upstream_allocations_; }
+
+private:
+  struct Destructor {
+    void (*destroy)(void *);
+    void *object;
+    Destructor *next;
+  };
+
+  // Header in front of each upstream allocation, so release() can return it.
+  struct Upstream_block {
+    Upstream_block *next;
+    std::size_t bytes;
+    std::size_t alignment;
+  };
+
+  template <typename T> static void destroy(void *object) {
+    static_cast<T *>(object)->~T();
+  }
+
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+  void do_deallocate(void *, std::size_t, std::size_t) override {}
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+
+  unsigned char *buffer_;
+  std::size_t size_;
+  std::size_t used_{0U};
+  std::pmr::memory_resource *upstream_;
+  uint64 upstream_allocations_{0U};
+  Destructor *destructors_{nullptr};
+  Upstream_block *upstream_blocks_{nullptr};
+};
+
+#endif // ECG_ARENA_H
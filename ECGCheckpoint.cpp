@@ -0,0 +1,109 @@
+#include "ECGCheckpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+void Checkpoint_writer::write_bytes(const void *data, std::size_t size) {
+  const uint8 *bytes = static_cast<const uint8 *>(data);
+  buffer_->insert(buffer_->end(), bytes, bytes + size);
+}
+
+void Checkpoint_writer::patch_u64(std::size_t position, uint64 value) {
+  if (position + sizeof(value) <= buffer_->size()) {
+    std::memcpy(buffer_->data() + position, &value, sizeof(value));
+  }
+}
+
+bool Checkpoint_reader::read_bytes(void *data, std::size_t size) {
+  if (!ok_ || size > remaining()) {
+    ok_ = false;
+    std::memset(data, 0, size);
+    return false;
+  }
+  std::memcpy(data, data_ + position_, size);
+  position_ += size;
+  return true;
+}
+
+uint32 Checkpoint_reader::read_u32() {
+  uint32 value = 0U;
+  read_bytes(&value, sizeof(value));
+  return value;
+}
+
+uint64 Checkpoint_reader::read_u64() {
+  uint64 value = 0U;
+  read_bytes(&value, sizeof(value));
+  return value;
+}
+
+float64 Checkpoint_reader::read_f64() {
+  float64 value = 0.0;
+  read_bytes(&value, sizeof(value));
+  return value;
+}
+
+void write_mt19937(Checkpoint_writer *writer, const std::mt19937 &engine) {
+  std::ostringstream text;
+  text << engine;
+
+  std::vector<uint64> words;
+  std::istringstream parse(text.str());
+  uint64 word = 0U;
+  while (parse >> word) {
+    words.push_back(word);
+  }
+
+  writer->write_u32(static_cast<uint32>(words.size()));
+  for (const uint64 w : words) {
+    // State words are 32-bit; the trailing position index is small.
+    writer->write_u32(static_cast<uint32>(w));
+  }
+}
+
+bool read_mt19937(Checkpoint_reader *reader, std::mt19937 *engine) {
+  const uint32 count = reader->read_u32();
+  if (!reader->ok() || count > (reader->remaining() / sizeof(uint32))) {
+    return false;
+  }
+
+  std::ostringstream text;
+  for (uint32 i = 0; i < count; ++i) {
+    text << reader->read_u32() << ' ';
+  }
+
+  std::istringstream parse(text.str());
+  parse >> *engine;
+  return reader->ok() && !parse.fail();
+}
+
+bool save_checkpoint_file(const std::string &path,
+                          const std::vector<uint8> &data) {
+  const std::string temp_path = path + ".tmp";
+  {
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      return false;
+    }
+    file.write(reinterpret_cast<const char *>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+    file.flush();
+    if (!file.good()) {
+      return false;
+    }
+  }
+  return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+bool load_checkpoint_file(const std::string &path, std::vector<uint8> *data) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  data->assign(std::istreambuf_iterator<char>(file),
+               std::istreambuf_iterator<char>());
+  return !file.bad();
+}
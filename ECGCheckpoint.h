@@ -0,0 +1,79 @@
+#ifndef ECG_CHECKPOINT_H
+#define ECG_CHECKPOINT_H
+
+#include "Types.h"
+
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Appends fixed-width values to a binary checkpoint buffer.
+ *
+ * Values are stored in native byte order: checkpoints resume a run on the
+ * same kind of machine, they are not an interchange format.
+ */
+class Checkpoint_writer {
+public:
+  // Clears `buffer` and writes into it. Capacity is kept, so a buffer that is
+  // reused for every checkpoint stops allocating after the first one.
+  explicit Checkpoint_writer(std::vector<uint8> *buffer) : buffer_(buffer) {
+    buffer_->clear();
+  }
+
+  void write_bytes(const void *data, std::size_t size);
+  void write_u32(uint32 value) { write_bytes(&value, sizeof(value)); }
+  void write_u64(uint64 value) { write_bytes(&value, sizeof(value)); }
+  void write_f64(float64 value) { write_bytes(&value, sizeof(value)); }
+  void write_bool(bool value) { write_u32(value ? 1U : 0U); }
+
+  // Overwrite a u64 written earlier at byte `position`, e.g. a length field
+  // that is only known after the section has been written.
+  void patch_u64(std::size_t position, uint64 value);
+
+  std::size_t size() const { return buffer_->size(); }
+
+private:
+  std::vector<uint8> *buffer_;
+};
+
+/**
+ * @brief Reads values back from a checkpoint buffer.
+ *
+ * Every read is bounds-checked. A short read marks the reader as failed and
+ * yields zero; callers check ok() once after reading a section.
+ */
+class Checkpoint_reader {
+public:
+  Checkpoint_reader(const uint8 *data, std::size_t size)
+      : data_(data), size_(size) {}
+
+  bool read_bytes(void *data, std::size_t size);
+  uint32 read_u32();
+  uint64 read_u64();
+  float64 read_f64();
+  bool read_bool() { return read_u32() != 0U; }
+
+  bool ok() const { return ok_; }
+  std::size_t remaining() const { return size_ - position_; }
+
+private:
+  const uint8 *data_;
+  std::size_t size_;
+  std::size_t position_{0U};
+  bool ok_{true};
+};
+
+// std::mt19937 only exposes its state through stream operators; these store
+// the state words in binary (about 2.5 KB) instead of as text.
+void write_mt19937(Checkpoint_writer *writer, const std::mt19937 &engine);
+bool read_mt19937(Checkpoint_reader *reader, std::mt19937 *engine);
+
+// Writes `data` to `path` through a temporary file and a rename, so a crash
+// while checkpointing leaves the previous checkpoint intact.
+bool save_checkpoint_file(const std::string &path,
+                          const std::vector<uint8> &data);
+bool load_checkpoint_file(const std::string &path, std::vector<uint8> *data);
+
+#endif // ECG_CHECKPOINT_H
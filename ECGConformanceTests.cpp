@@ -0,0 +1,264 @@
+// Differential conformance suite: every accelerated rendering mode is run
+// against the reference double-precision engine (ECGSimulationEngine::
+// generate(), i.e. calculate_sample()) over randomized scenarios. For each
+// mode the max and RMS error per lead are checked against the mode's declared
+// budget, and the throughput of every mode is measured in the same run so
+// accuracy costs and speedups are reported side by side.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "ECGFixedPoint.h"
+#include "ECGMorphology.h"
+#include "ECGSimulation.h"
+
+namespace
+{
+
+struct Conformance_scenario
+{
+    Ecg_morphology morphology;
+    float64 heart_rate_bpm;
+    float64 sampling_rate_hz;
+    float64 duration_s;
+};
+
+// Clean output of a scenario, lead-major: leads[lead][sample].
+typedef std::array<std::vector<float64>, standard_lead_count> Lead_columns;
+
+struct Conformance_mode
+{
+    const char *name;
+    float64 max_abs_budget_mv;
+    float64 rms_budget_mv;
+    std::function<void(const Conformance_scenario &, std::size_t, Lead_columns *)> render;
+};
+
+struct Lead_error
+{
+    float64 max_abs{0.0};
+    float64 sum_squares{0.0};
+};
+
+const uint32 conformance_seed = 20240611U;
+const int32 scenario_count = 24;
+const std::size_t conformance_block_samples = 1024U;
+
+std::vector<Conformance_scenario> make_scenarios()
+{
+    std::mt19937 rng(conformance_seed);
+    std::uniform_real_distribution<float64> pr(0.12, 0.20);
+    std::uniform_real_distribution<float64> qrs(0.06, 0.12);
+    std::uniform_real_distribution<float64> axis(-30.0, 110.0);
+    std::uniform_real_distribution<float64> asymmetry(-0.5, 1.0);
+    std::uniform_real_distribution<float64> heart_rate(40.0, 180.0);
+    const std::array<float64, 5> sampling_rates = {250.0, 360.0, 500.0, 1000.0, 2000.0};
+
+    std::vector<Conformance_scenario> scenarios;
+    for (int32 i = 0; i < scenario_count; ++i)
+    {
+        Conformance_scenario scenario{};
+        scenario.morphology = create_normal_sinus_morphology(pr(rng), qrs(rng), axis(rng));
+        scenario.morphology.t_wave.shape_params.asymmetry = asymmetry(rng);
+        scenario.morphology.p_wave.shape_params.asymmetry = asymmetry(rng);
+        scenario.heart_rate_bpm = heart_rate(rng);
+        scenario.sampling_rate_hz = sampling_rates[static_cast<std::size_t>(i) % sampling_rates.size()];
+        scenario.duration_s = 4.0;
+        scenarios.push_back(scenario);
+    }
+    return scenarios;
+}
+
+void render_reference(const Conformance_scenario &scenario, std::size_t, Lead_columns *out)
+{
+    ECGSimulationEngine engine(scenario.morphology, scenario.heart_rate_bpm, scenario.sampling_rate_hz);
+    const std::vector<Lead_sample> samples = engine.generate(scenario.duration_s);
+    for (std::size_t lead = 0; lead < standard_lead_count; ++lead)
+    {
+        (*out)[lead].resize(samples.size());
+        for (std::size_t i = 0; i < samples.size(); ++i)
+        {
+            (*out)[lead][i] = samples[i].leads[lead];
+        }
+    }
+}
+
+// Renders through ECGSimulationEngine::render_block() with a given kernel.
+std::function<void(const Conformance_scenario &, std::size_t, Lead_columns *)>
+block_renderer(Morphology_kernel kernel)
+{
+    return [kernel](const Conformance_scenario &scenario, std::size_t count, Lead_columns *out) {
+        ECGSimulationEngine engine(scenario.morphology, scenario.heart_rate_bpm, scenario.sampling_rate_hz);
+        engine.set_morphology_kernel(kernel);
+        Sample_block block{};
+        allocate_sample_block(&block, conformance_block_samples, standard_lead_count);
+        for (auto &column : *out)
+        {
+            column.resize(count);
+        }
+        std::size_t done = 0U;
+        while (done < count)
+        {
+            const std::size_t n = engine.render_block(&block, count - done);
+            for (std::size_t lead = 0; lead < standard_lead_count; ++lead)
+            {
+                std::copy(lead_column(&block, lead), lead_column(&block, lead) + n,
+                          (*out)[lead].begin() + static_cast<std::ptrdiff_t>(done));
+            }
+            done += n;
+        }
+    };
+}
+
+// Queries the sample grid through ECGSimulationEngine::evaluate(), in a
+// shuffled order so the internal sort and scatter are exercised.
+void render_evaluate(const Conformance_scenario &scenario, std::size_t count, Lead_columns *out)
+{
+    ECGSimulationEngine engine(scenario.morphology, scenario.heart_rate_bpm, scenario.sampling_rate_hz);
+    std::vector<std::size_t> order(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        order[i] = i;
+    }
+    std::mt19937 rng(conformance_seed);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    std::vector<float64> times(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        times[i] = static_cast<float64>(order[i]) * (1.0 / scenario.sampling_rate_hz);
+    }
+    std::vector<float64> leads(count * standard_lead_count);
+    engine.evaluate(times.data(), count, leads.data(), count);
+    for (std::size_t lead = 0; lead < standard_lead_count; ++lead)
+    {
+        (*out)[lead].resize(count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            (*out)[lead][order[i]] = leads[(lead * count) + i];
+        }
+    }
+}
+
+// Renders through the integer-only Fixed_point_engine and converts to mV.
+void render_fixed_point(const Conformance_scenario &scenario, std::size_t count, Lead_columns *out)
+{
+    Fixed_engine_config config{};
+    make_fixed_engine_config(scenario.morphology, scenario.heart_rate_bpm, scenario.sampling_rate_hz,
+                             Lead_matrix::standard_12(), &config);
+    Fixed_point_engine engine(config);
+    std::vector<int32> codes(conformance_block_samples * standard_lead_count);
+    for (auto &column : *out)
+    {
+        column.resize(count);
+    }
+    std::size_t done = 0U;
+    while (done < count)
+    {
+        const std::size_t n = std::min(conformance_block_samples, count - done);
+        engine.render_block(codes.data(), n, conformance_block_samples);
+        for (std::size_t lead = 0; lead < standard_lead_count; ++lead)
+        {
+            for (std::size_t i = 0; i < n; ++i)
+            {
+                (*out)[lead][done + i] = fixed_to_mv(codes[(lead * conformance_block_samples) + i]);
+            }
+        }
+        done += n;
+    }
+}
+
+// The registry of accelerated modes and their declared error budgets (mV).
+// New fast paths must be added here.
+std::vector<Conformance_mode> accelerated_modes()
+{
+    return {
+        {"block", 1e-12, 1e-13, block_renderer(morphology_kernel_reference)},
+        {"fast_exp", 1e-9, 5e-11, block_renderer(morphology_kernel_fast_exp)},
+        {"float32", 2e-5, 1e-6, block_renderer(morphology_kernel_float32)},
+        {"fixed_q15", fixed_point_max_error_mv, 3e-5, render_fixed_point},
+        {"evaluate", 1e-12, 1e-13, render_evaluate},
+    };
+}
+
+const char *const lead_names[standard_lead_count] = {"I",  "II", "III", "aVR", "aVL", "aVF",
+                                                     "V1", "V2", "V3",  "V4",  "V5",  "V6"};
+
+} // namespace
+
+TEST(Conformance, FastExpMatchesStdExp)
+{
+    for (int32 step = 0; step <= 40000; ++step)
+    {
+        const float64 x = -static_cast<float64>(step) * 0.001;
+        const float64 expected = std::exp(x);
+        EXPECT_LE(std::abs(fast_exp(x) - expected), 1e-9 * expected) << "x = " << x;
+    }
+    EXPECT_EQ(fast_exp(-1000.0), 0.0);
+}
+
+TEST(Conformance, AcceleratedModesWithinBudget)
+{
+    const std::vector<Conformance_scenario> scenarios = make_scenarios();
+
+    // Reference outputs and timing.
+    std::vector<Lead_columns> reference(scenarios.size());
+    uint64 total_samples = 0U;
+    const auto reference_start = std::chrono::steady_clock::now();
+    for (std::size_t s = 0; s < scenarios.size(); ++s)
+    {
+        render_reference(scenarios[s], 0U, &reference[s]);
+        total_samples += reference[s][0].size();
+    }
+    const float64 reference_s =
+        std::chrono::duration<float64>(std::chrono::steady_clock::now() - reference_start).count();
+    const float64 reference_rate = static_cast<float64>(total_samples) / reference_s;
+
+    std::printf("[conformance] %-10s %12.0f samples/s  (reference)\n", "reference", reference_rate);
+
+    for (const Conformance_mode &mode : accelerated_modes())
+    {
+        std::array<Lead_error, standard_lead_count> errors{};
+        float64 elapsed_s = 0.0;
+
+        for (std::size_t s = 0; s < scenarios.size(); ++s)
+        {
+            const std::size_t count = reference[s][0].size();
+            Lead_columns candidate;
+            const auto start = std::chrono::steady_clock::now();
+            mode.render(scenarios[s], count, &candidate);
+            elapsed_s += std::chrono::duration<float64>(std::chrono::steady_clock::now() - start).count();
+
+            for (std::size_t lead = 0; lead < standard_lead_count; ++lead)
+            {
+                ASSERT_EQ(candidate[lead].size(), count) << mode.name;
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    const float64 diff = std::abs(candidate[lead][i] - reference[s][lead][i]);
+                    errors[lead].max_abs = std::max(errors[lead].max_abs, diff);
+                    errors[lead].sum_squares += diff * diff;
+                }
+            }
+        }
+
+        const float64 rate = static_cast<float64>(total_samples) / elapsed_s;
+        std::printf("[conformance] %-10s %12.0f samples/s  (%.2fx reference)\n", mode.name, rate,
+                    rate / reference_rate);
+
+        for (std::size_t lead = 0; lead < standard_lead_count; ++lead)
+        {
+            const float64 rms = std::sqrt(errors[lead].sum_squares / static_cast<float64>(total_samples));
+            std::printf("[conformance]   %-4s max %.3e  rms %.3e\n", lead_names[lead], errors[lead].max_abs, rms);
+            EXPECT_LE(errors[lead].max_abs, mode.max_abs_budget_mv) << mode.name << " lead " << lead_names[lead];
+            EXPECT_LE(rms, mode.rms_budget_mv) << mode.name << " lead " << lead_names[lead];
+        }
+    }
+}
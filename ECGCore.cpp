@@ -0,0 +1,214 @@
+#include "ECGCore.h"
+
+#include "ECGSimulation.h"
+#include "NoiseGenerator.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <new>
+
+// Rule 151: Avoid magic numbers. Defaults match the command line tool.
+namespace {
+const float64 default_pr_interval_s = 0.16;
+const float64 default_qrs_duration_s = 0.10;
+const float64 default_qrs_axis_degrees = 60.0;
+const float64 zero_tolerance = 1e-9;
+} // namespace
+
+// The engine plus the one block it renders into; the caller's buffers are
+// filled from that block, so generating never allocates.
+struct Ecg_core_engine {
+  Ecg_core_engine(float64 heart_rate_bpm, float64 sampling_rate_hz,
+                  std::size_t block_samples)
+      : engine(create_normal_sinus_morphology(default_pr_interval_s,
+                                              default_qrs_duration_s,
+                                              default_qrs_axis_degrees),
+               heart_rate_bpm, sampling_rate_hz) {
+    allocate_sample_block(&block, block_samples, engine.lead_count());
+  }
+
+  ECGSimulationEngine engine;
+  Sample_block block;
+  uint64 calls{0U};
+  uint64 samples{0U};
+  float64 busy_s{0.0};
+};
+
+namespace {
+// Runs `body`, translating any exception into a status code.
+template <typename Body> Ecg_core_status guarded(Body body) {
+  try {
+    return body();
+  } catch (const std::bad_alloc &) {
+    return ecg_core_out_of_memory;
+  } catch (...) {
+    return ecg_core_internal_error;
+  }
+}
+} // namespace
+
+extern "C" {
+
+uint32_t ecg_core_abi_version(void) { return ECG_CORE_ABI_VERSION; }
+
+const char *ecg_core_status_string(Ecg_core_status status) {
+  switch (status) {
+  case ecg_core_ok:
+    return "ok";
+  case ecg_core_invalid_argument:
+    return "invalid argument";
+  case ecg_core_out_of_memory:
+    return "out of memory";
+  case ecg_core_internal_error:
+    return "internal error";
+  }
+  return "unknown status";
+}
+
+Ecg_core_status ecg_core_create(double heart_rate_bpm, double sampling_rate_hz,
+                                size_t block_samples,
+                                Ecg_core_engine **engine) {
+  if (engine == nullptr) {
+    return ecg_core_invalid_argument;
+  }
+  *engine = nullptr;
+  if (heart_rate_bpm <= zero_tolerance || sampling_rate_hz <= zero_tolerance ||
+      block_samples == 0U) {
+    return ecg_core_invalid_argument;
+  }
+  return guarded([&]() {
+    *engine =
+        new Ecg_core_engine(heart_rate_bpm, sampling_rate_hz, block_samples);
+    return ecg_core_ok;
+  });
+}
+
+void ecg_core_destroy(Ecg_core_engine *engine) { delete engine; }
+
+Ecg_core_status ecg_core_set_morphology(Ecg_core_engine *engine,
+                                        const Ecg_core_morphology *morphology) {
+  if (engine == nullptr || morphology == nullptr ||
+      morphology->pr_interval_s <= 0.0 || morphology->qrs_duration_s <= 0.0) {
+    return ecg_core_invalid_argument;
+  }
+  engine->engine.set_morphology(create_normal_sinus_morphology(
+      morphology->pr_interval_s, morphology->qrs_duration_s,
+      morphology->qrs_axis_degrees));
+  return ecg_core_ok;
+}
+
+Ecg_core_status ecg_core_set_kernel(Ecg_core_engine *engine,
+                                    Ecg_core_kernel kernel) {
+  if (engine == nullptr || kernel < ecg_core_kernel_reference ||
+      kernel > ecg_core_kernel_float32) {
+    return ecg_core_invalid_argument;
+  }
+  engine->engine.set_morphology_kernel(static_cast<Morphology_kernel>(kernel));
+  return ecg_core_ok;
+}
+
+Ecg_core_status ecg_core_set_noise(Ecg_core_engine *engine,
+                                   const Ecg_core_noise *noise) {
+  if (engine == nullptr || noise == nullptr) {
+    return ecg_core_invalid_argument;
+  }
+  // A hum at 0 Hz (the zero-initialized default) would be a DC offset.
+  const bool has_mains = std::abs(noise->mains_amplitude_mv) > zero_tolerance;
+  if (has_mains && !(noise->mains_frequency_hz > 0.0)) {
+    return ecg_core_invalid_argument;
+  }
+  return guarded([&]() {
+    ECGSimulationEngine &sim = engine->engine;
+    sim.clear_noise_sources();
+    if (std::abs(noise->white_amplitude_mv) > zero_tolerance) {
+      if (noise->white_seed != 0U) {
+        sim.add_noise_source(std::make_shared<WhiteNoiseGenerator>(
+            noise->white_amplitude_mv, noise->white_seed));
+      } else {
+        sim.add_noise_source(
+            std::make_shared<WhiteNoiseGenerator>(noise->white_amplitude_mv));
+      }
+    }
+    if (std::abs(noise->wander_amplitude_mv) > zero_tolerance) {
+      sim.add_noise_source(std::make_shared<BaselineWanderGenerator>(
+          noise->wander_amplitude_mv));
+    }
+    if (has_mains) {
+      sim.add_noise_source(std::make_shared<MainsHumGenerator>(
+          noise->mains_amplitude_mv, noise->mains_frequency_hz));
+    }
+    return ecg_core_ok;
+  });
+}
+
+Ecg_core_status ecg_core_seek(Ecg_core_engine *engine, uint64_t sample_index) {
+  if (engine == nullptr) {
+    return ecg_core_invalid_argument;
+  }
+  engine->engine.seek(sample_index);
+  return ecg_core_ok;
+}
+
+size_t ecg_core_lead_count(const Ecg_core_engine *engine) {
+  return (engine != nullptr) ? engine->engine.lead_count() : 0U;
+}
+
+const char *ecg_core_lead_name(const Ecg_core_engine *engine, size_t lead) {
+  if (engine == nullptr || lead >= engine->engine.lead_count()) {
+    return nullptr;
+  }
+  return engine->engine.lead_matrix().name(lead).c_str();
+}
+
+Ecg_core_status ecg_core_generate(Ecg_core_engine *engine, size_t count,
+                                  double *time_s, double *leads,
+                                  size_t lead_stride) {
+  if (engine == nullptr || leads == nullptr || lead_stride < count) {
+    return ecg_core_invalid_argument;
+  }
+  return guarded([&]() {
+    const auto start = std::chrono::steady_clock::now();
+    Sample_block &block = engine->block;
+    std::size_t done = 0U;
+    while (done < count) {
+      const std::size_t n =
+          engine->engine.generate_block(&block, count - done);
+      if (n == 0U) {
+        return ecg_core_internal_error;
+      }
+      for (std::size_t lead = 0; lead < block.lead_count; ++lead) {
+        std::memcpy(leads + (lead * lead_stride) + done,
+                    lead_column(&block, lead), n * sizeof(double));
+      }
+      if (time_s != nullptr) {
+        std::memcpy(time_s + done, block.time_s.data(), n * sizeof(double));
+      }
+      done += n;
+    }
+    ++engine->calls;
+    engine->samples += count;
+    engine->busy_s += std::chrono::duration<float64>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    return ecg_core_ok;
+  });
+}
+
+Ecg_core_status ecg_core_get_stats(const Ecg_core_engine *engine,
+                                   Ecg_core_stats *stats) {
+  if (engine == nullptr || stats == nullptr) {
+    return ecg_core_invalid_argument;
+  }
+  stats->calls = engine->calls;
+  stats->samples = engine->samples;
+  stats->busy_s = engine->busy_s;
+  stats->next_sample_index = engine->engine.next_sample_index();
+  stats->lead_count = engine->engine.lead_count();
+  stats->heart_rate_bpm = engine->engine.heart_rate_bpm();
+  stats->sampling_rate_hz = engine->engine.sampling_rate_hz();
+  return ecg_core_ok;
+}
+
+} // extern "C"
@@ -0,0 +1,140 @@
+#ifndef ECG_CORE_H
+#define ECG_CORE_H
+
+/*
+ * C interface of the ecg_core library, for embedding the generator in other
+ * processes and languages.
+ *
+ * The header is plain C: the fixed-width types come from <stdint.h> rather
+ * than Types.h. Every function reports failure through its return value; no
+ * C++ exception crosses this boundary. Engines allocate all of their working
+ * memory when they are created or reconfigured, so ecg_core_generate() does
+ * not allocate and writes only into buffers the caller owns.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(ECG_CORE_SHARED)
+#if defined(ECG_CORE_BUILDING)
+#define ECG_CORE_API __declspec(dllexport)
+#else
+#define ECG_CORE_API __declspec(dllimport)
+#endif
+#elif defined(__GNUC__)
+#define ECG_CORE_API __attribute__((visibility("default")))
+#else
+#define ECG_CORE_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped whenever a declaration in this header changes incompatibly. */
+#define ECG_CORE_ABI_VERSION 1
+
+typedef enum Ecg_core_status {
+  ecg_core_ok = 0,
+  ecg_core_invalid_argument,
+  ecg_core_out_of_memory,
+  ecg_core_internal_error
+} Ecg_core_status;
+
+/* Morphology evaluators; values match Morphology_kernel. */
+typedef enum Ecg_core_kernel {
+  ecg_core_kernel_reference = 0,
+  ecg_core_kernel_fast_exp,
+  ecg_core_kernel_float32
+} Ecg_core_kernel;
+
+typedef struct Ecg_core_engine Ecg_core_engine; /* opaque */
+
+/* Parameters of create_normal_sinus_morphology(). */
+typedef struct Ecg_core_morphology {
+  double pr_interval_s;
+  double qrs_duration_s;
+  double qrs_axis_degrees;
+} Ecg_core_morphology;
+
+/* Noise sources added after the morphology; an amplitude of 0 disables a
+ * source. A white noise seed of 0 picks a non-deterministic seed. Mains hum
+ * needs a frequency above 0 (e.g. 50 or 60 Hz) whenever its amplitude is
+ * non-zero; ecg_core_set_noise() rejects it otherwise. */
+typedef struct Ecg_core_noise {
+  double white_amplitude_mv;
+  uint32_t white_seed;
+  double wander_amplitude_mv;
+  double mains_amplitude_mv;
+  double mains_frequency_hz;
+} Ecg_core_noise;
+
+typedef struct Ecg_core_stats {
+  uint64_t calls;             /* successful ecg_core_generate() calls */
+  uint64_t samples;           /* samples produced by those calls */
+  double busy_s;              /* time spent inside them */
+  uint64_t next_sample_index; /* stream cursor */
+  size_t lead_count;
+  double heart_rate_bpm;
+  double sampling_rate_hz;
+} Ecg_core_stats;
+
+ECG_CORE_API uint32_t ecg_core_abi_version(void);
+
+/* Short English description of a status code (static storage). */
+ECG_CORE_API const char *ecg_core_status_string(Ecg_core_status status);
+
+/*
+ * Create an engine with the default morphology, the standard 12 leads and no
+ * noise. `block_samples` is the size of the internal render block; larger
+ * requests are rendered in several blocks.
+ */
+ECG_CORE_API Ecg_core_status ecg_core_create(double heart_rate_bpm,
+                                             double sampling_rate_hz,
+                                             size_t block_samples,
+                                             Ecg_core_engine **engine);
+
+/* Accepts NULL. */
+ECG_CORE_API void ecg_core_destroy(Ecg_core_engine *engine);
+
+ECG_CORE_API Ecg_core_status
+ecg_core_set_morphology(Ecg_core_engine *engine,
+                        const Ecg_core_morphology *morphology);
+
+ECG_CORE_API Ecg_core_status ecg_core_set_kernel(Ecg_core_engine *engine,
+                                                 Ecg_core_kernel kernel);
+
+/* Replaces all noise sources. On ecg_core_invalid_argument the previous
+ * sources are kept. */
+ECG_CORE_API Ecg_core_status
+ecg_core_set_noise(Ecg_core_engine *engine, const Ecg_core_noise *noise);
+
+/* Move the stream cursor; the next sample generated is `sample_index`. */
+ECG_CORE_API Ecg_core_status ecg_core_seek(Ecg_core_engine *engine,
+                                           uint64_t sample_index);
+
+ECG_CORE_API size_t ecg_core_lead_count(const Ecg_core_engine *engine);
+
+/* Lead name (e.g. "lead_II"), or NULL for an invalid lead. */
+ECG_CORE_API const char *ecg_core_lead_name(const Ecg_core_engine *engine,
+                                            size_t lead);
+
+/*
+ * Generate the next `count` samples. Lead l of sample i is written to
+ * leads[l * lead_stride + i], so lead_stride must be at least count.
+ * `time_s` receives the sample times and may be NULL. Always produces
+ * `count` samples unless an argument is invalid.
+ */
+ECG_CORE_API Ecg_core_status ecg_core_generate(Ecg_core_engine *engine,
+                                               size_t count, double *time_s,
+                                               double *leads,
+                                               size_t lead_stride);
+
+ECG_CORE_API Ecg_core_status ecg_core_get_stats(const Ecg_core_engine *engine,
+                                                Ecg_core_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ECG_CORE_H */
@@ -0,0 +1,84 @@
+#include "ECGFft.h"
+
+#include "ECGMath.h"
+
+#include <cmath>
+#include <utility>
+
+namespace {
+// Rule 151: Avoid magic numbers.
+const float64 two_pi = 2.0 * pi_value;
+} // namespace
+
+bool Fft_plan::configure(std::size_t size) {
+  if (size < 2U || !is_power_of_two(size)) {
+    return false;
+  }
+  size_ = size;
+
+  std::size_t bits = 0U;
+  while ((std::size_t{1} << bits) < size) {
+    ++bits;
+  }
+  bit_reverse_.assign(size, 0U);
+  for (std::size_t i = 0; i < size; ++i) {
+    std::size_t reversed = 0U;
+    for (std::size_t b = 0; b < bits; ++b) {
+      reversed |= ((i >> b) & 1U) << (bits - 1U - b);
+    }
+    bit_reverse_[i] = reversed;
+  }
+
+  cos_.assign(size / 2U, 0.0);
+  sin_.assign(size / 2U, 0.0);
+  for (std::size_t k = 0; k < size / 2U; ++k) {
+    const float64 angle =
+        two_pi * static_cast<float64>(k) / static_cast<float64>(size);
+    cos_[k] = std::cos(angle);
+    sin_[k] = std::sin(angle);
+  }
+  return true;
+}
+
+void Fft_plan::forward(float64 *re, float64 *im) const {
+  transform(re, im, -1.0);
+}
+
+void Fft_plan::inverse(float64 *re, float64 *im) const {
+  transform(re, im, 1.0);
+  const float64 scale = 1.0 / static_cast<float64>(size_);
+  for (std::size_t i = 0; i < size_; ++i) {
+    re[i] *= scale;
+    im[i] *= scale;
+  }
+}
+
+void Fft_plan::transform(float64 *re, float64 *im, float64 direction) const {
+  for (std::size_t i = 0; i < size_; ++i) {
+    const std::size_t j = bit_reverse_[i];
+    if (i < j) {
+      std::swap(re[i], re[j]);
+      std::swap(im[i], im[j]);
+    }
+  }
+
+  // Iterative decimation in time: butterflies of span `half` combine pairs
+  // of transforms of length `half` into transforms of length 2 * half.
+  for (std::size_t half = 1U; half < size_; half *= 2U) {
+    const std::size_t step = size_ / (2U * half);
+    for (std::size_t start = 0; start < size_; start += 2U * half) {
+      for (std::size_t k = 0; k < half; ++k) {
+        const float64 wr = cos_[k * step];
+        const float64 wi = direction * sin_[k * step];
+        const std::size_t a = start + k;
+        const std::size_t b = a + half;
+        const float64 tr = (re[b] * wr) - (im[b] * wi);
+        const float64 ti = (re[b] * wi) + (im[b] * wr);
+        re[b] = re[a] - tr;
+        im[b] = im[a] - ti;
+        re[a] += tr;
+        im[a] += ti;
+      }
+    }
+  }
+}
@@ -0,0 +1,42 @@
+#ifndef ECG_FFT_H
+#define ECG_FFT_H
+
+#include "Types.h"
+
+#include <cstddef>
+#include <vector>
+
+inline bool is_power_of_two(std::size_t n) {
+  return n != 0U && (n & (n - 1U)) == 0U;
+}
+
+/**
+ * @brief In-place radix-2 complex FFT of one fixed size.
+ *
+ * Twiddle factors and the bit-reversal permutation are computed once by
+ * configure(), so transforms do not allocate. Real and imaginary parts are
+ * separate arrays.
+ */
+class Fft_plan {
+public:
+  Fft_plan() = default;
+
+  // Returns false unless `size` is a power of two of at least 2.
+  bool configure(std::size_t size);
+  std::size_t size() const { return size_; }
+
+  // X[k] = sum_n x[n] exp(-2 pi i n k / size)
+  void forward(float64 *re, float64 *im) const;
+  // Inverse of forward(), including the 1 / size scaling.
+  void inverse(float64 *re, float64 *im) const;
+
+private:
+  void transform(float64 *re, float64 *im, float64 direction) const;
+
+  std::size_t size_{0U};
+  std::vector<std::size_t> bit_reverse_;
+  std::vector<float64> cos_; // cos(2 pi k / size), k < size / 2
+  std::vector<float64> sin_; // sin(2 pi k / size), k < size / 2
+};
+
+#endif // ECG_FFT_H
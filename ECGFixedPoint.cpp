@@ -0,0 +1,146 @@
+#include "ECGFixedPoint.h"
+
+// Integer-only: this file must not use floating point at run time (the
+// ecg_fixed target builds it without floating-point registers). The double
+// arithmetic below is evaluated by the compiler.
+
+namespace {
+// Rule 151: Avoid magic numbers.
+const int32 q15_max = (1 << q15_shift) - 1;
+const int32 table_fraction_bits = 16;
+const uint64 table_fraction_mask = (uint64{1} << table_fraction_bits) - 1U;
+const std::size_t heart_tile_samples = 64U;
+
+// --- Compile-time exp(-x^2) table ---
+constexpr float64 exp_taylor(float64 x) {
+  float64 term = 1.0;
+  float64 sum = 1.0;
+  for (int32 k = 1; k <= 16; ++k) {
+    term *= x / static_cast<float64>(k);
+    sum += term;
+  }
+  return sum;
+}
+
+// exp(y) for y <= 0: halve into [-0.5, 0], sum the series, square back.
+constexpr float64 exp_non_positive(float64 y) {
+  int32 halvings = 0;
+  while (y < -0.5) {
+    y *= 0.5;
+    ++halvings;
+  }
+  float64 result = exp_taylor(y);
+  for (int32 i = 0; i < halvings; ++i) {
+    result *= result;
+  }
+  return result;
+}
+
+typedef std::array<int16, gaussian_table_intervals + 1U> Gaussian_table;
+
+constexpr Gaussian_table make_gaussian_table() {
+  Gaussian_table table{};
+  for (std::size_t i = 0; i <= gaussian_table_intervals; ++i) {
+    const float64 x = static_cast<float64>(i) *
+                      static_cast<float64>(gaussian_table_range) /
+                      static_cast<float64>(gaussian_table_intervals);
+    const float64 value =
+        exp_non_positive(-(x * x)) * static_cast<float64>(1 << q15_shift);
+    const int32 rounded = static_cast<int32>(value + 0.5);
+    table[i] = static_cast<int16>((rounded > q15_max) ? q15_max : rounded);
+  }
+  return table;
+}
+
+constexpr Gaussian_table gaussian_table = make_gaussian_table();
+static_assert(gaussian_table[0] == q15_max, "exp(0) saturates to Q15 one");
+static_assert(gaussian_table[gaussian_table_intervals] == 0,
+              "the table must decay to zero at its range");
+
+// Round-half-away-from-zero right shift, written without shifting negative
+// values so the result does not depend on the platform.
+inline int64 round_shift(int64 value, int32 shift) {
+  const int64 half = int64{1} << (shift - 1);
+  return (value >= 0) ? ((value + half) >> shift)
+                      : -((-value + half) >> shift);
+}
+} // namespace
+
+int32 fixed_gaussian(uint64 position) {
+  const uint64 index = position >> table_fraction_bits;
+  if (index >= gaussian_table_intervals) {
+    return 0;
+  }
+  const uint32 fraction = static_cast<uint32>(position & table_fraction_mask);
+  const uint32 a = static_cast<uint32>(gaussian_table[index]);
+  const uint32 b = static_cast<uint32>(gaussian_table[index + 1U]);
+  // The table decreases, so a - b >= 0 and the product fits in 32 bits.
+  return static_cast<int32>(a - (((a - b) * fraction) >> table_fraction_bits));
+}
+
+Fixed_point_engine::Fixed_point_engine(const Fixed_engine_config &config)
+    : config_(config) {}
+
+void Fixed_point_engine::seek(uint64 sample_index) {
+  next_sample_index_ = sample_index;
+  phase_ = sample_index * config_.phase_increment; // modulo one cycle
+}
+
+void Fixed_point_engine::heart_vector(uint32 phase, int32 *x, int32 *y,
+                                      int32 *z) const {
+  int64 sum_x = 0;
+  int64 sum_y = 0;
+  int64 sum_z = 0;
+  for (std::size_t g = 0; g < config_.gaussian_count; ++g) {
+    const Fixed_gaussian &gaussian = config_.gaussians[g];
+    const uint32 local = phase - gaussian.start_phase; // wraps when before
+    if (local > gaussian.duration_phase) {
+      continue;
+    }
+    const uint64 position =
+        (local >= gaussian.center_phase)
+            ? (static_cast<uint64>(local - gaussian.center_phase) *
+               gaussian.right_scale) >>
+                  table_fraction_bits
+            : (static_cast<uint64>(gaussian.center_phase - local) *
+               gaussian.left_scale) >>
+                  table_fraction_bits;
+    const int64 magnitude = fixed_gaussian(position);
+    sum_x += gaussian.amplitude_x * magnitude;
+    sum_y += gaussian.amplitude_y * magnitude;
+    sum_z += gaussian.amplitude_z * magnitude;
+  }
+  *x = static_cast<int32>(round_shift(sum_x, q15_shift));
+  *y = static_cast<int32>(round_shift(sum_y, q15_shift));
+  *z = static_cast<int32>(round_shift(sum_z, q15_shift));
+}
+
+void Fixed_point_engine::render_block(int32 *leads, std::size_t count,
+                                      std::size_t lead_stride) {
+  const std::size_t lead_total = lead_count();
+  int32 hx[heart_tile_samples];
+  int32 hy[heart_tile_samples];
+  int32 hz[heart_tile_samples];
+
+  for (std::size_t begin = 0; begin < count; begin += heart_tile_samples) {
+    const std::size_t n = (count - begin < heart_tile_samples)
+                              ? count - begin
+                              : heart_tile_samples;
+    for (std::size_t i = 0; i < n; ++i) {
+      heart_vector(static_cast<uint32>(phase_ >> 32), &hx[i], &hy[i], &hz[i]);
+      phase_ += config_.phase_increment;
+    }
+
+    for (std::size_t lead = 0; lead < lead_total; ++lead) {
+      const int64 lx = config_.lead_x[lead];
+      const int64 ly = config_.lead_y[lead];
+      const int64 lz = config_.lead_z[lead];
+      int32 *out = leads + (lead * lead_stride) + begin;
+      for (std::size_t i = 0; i < n; ++i) {
+        out[i] = static_cast<int32>(round_shift(
+            (hx[i] * lx) + (hy[i] * ly) + (hz[i] * lz), q31_shift));
+      }
+    }
+  }
+  next_sample_index_ += count;
+}
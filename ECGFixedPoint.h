@@ -0,0 +1,112 @@
+#ifndef ECG_FIXED_POINT_H
+#define ECG_FIXED_POINT_H
+
+#include "ECGLeadMatrix.h"
+#include "ECGMorphology.h"
+#include "Types.h"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+/**
+ * Fixed-point engine for targets without an FPU.
+ *
+ * Rendering uses integer arithmetic only, so its output is bit-exact on
+ * every platform:
+ *
+ *   - the beat phase is a 64-bit accumulator in units of 2^-64 cycles, which
+ *     replaces std::fmod(t, cycle);
+ *   - each Gaussian is read from a Q15 table of exp(-x^2) with linear
+ *     interpolation; the table is computed at compile time;
+ *   - heart vector components and lead samples are Q15 millivolts (an int32
+ *     v means v / 2^15 mV), and the lead projection accumulates Q15 x Q31
+ *     products in 64 bits.
+ *
+ * The floating-point morphology and lead matrix are converted once, at
+ * setup, by make_fixed_engine_config() (ECGFixedPointSetup.cpp). Only
+ * ECGFixedPoint.cpp is needed on the target; the ecg_fixed build target
+ * compiles it without floating-point registers where the compiler allows.
+ */
+
+// Rule 151: Avoid magic numbers.
+const int32 q15_shift = 15;
+const int32 q31_shift = 31;
+
+// exp(-x^2) is tabulated for x in [0, gaussian_table_range] in
+// gaussian_table_intervals steps; beyond the range it is below 2^-23 and
+// reads as zero.
+const std::size_t gaussian_table_intervals = 1024U;
+const int32 gaussian_table_range = 4;
+
+// Largest difference from the floating-point engine (ECGSimulationEngine::
+// generate()), in mV: a few Q15 roundings of the table, the heart vector and
+// the projection, and well below one 2.5 uV ADC code. It does not hold at
+// samples within a few 2^-32 cycles of a component edge or beat boundary,
+// where the two engines' phase rounding can disagree about which side of
+// the discontinuity the sample is on.
+const float64 fixed_point_max_error_mv = 2e-4;
+
+// P wave, the QRS Gaussians and T wave.
+const std::size_t max_fixed_gaussians = 2U + qrs_wave_count;
+
+struct Fixed_gaussian {
+  uint32 start_phase;    // 2^-32 cycles from the beat start
+  uint32 duration_phase; // 2^-32 cycles; never extends past the beat end
+  uint32 center_phase;   // peak, relative to start_phase
+  // Table position per 2^-32 cycle from the peak, scaled by 2^32 / table
+  // step; separate sides for asymmetric waves.
+  uint32 left_scale;
+  uint32 right_scale;
+  int32 amplitude_x; // Q15 mV at the peak
+  int32 amplitude_y;
+  int32 amplitude_z;
+};
+
+struct Fixed_engine_config {
+  std::array<Fixed_gaussian, max_fixed_gaussians> gaussians;
+  std::size_t gaussian_count;
+  uint64 phase_increment; // 2^-64 cycles per sample
+  // Lead directions, Q31, one entry per lead.
+  std::vector<int32> lead_x;
+  std::vector<int32> lead_y;
+  std::vector<int32> lead_z;
+};
+
+// Setup-time conversion (uses floating point). Returns false for a
+// non-positive rate or more than one beat per sample.
+bool make_fixed_engine_config(const Ecg_morphology &morphology,
+                              float64 heart_rate_bpm, float64 sampling_rate_hz,
+                              const Lead_matrix &lead_matrix,
+                              Fixed_engine_config *config);
+
+inline float64 fixed_to_mv(int32 value) {
+  return static_cast<float64>(value) / static_cast<float64>(1 << q15_shift);
+}
+
+// Q15 exp(-x^2) for x = position / 2^16 table steps.
+int32 fixed_gaussian(uint64 position);
+
+class Fixed_point_engine {
+public:
+  explicit Fixed_point_engine(const Fixed_engine_config &config);
+
+  std::size_t lead_count() const { return config_.lead_x.size(); }
+
+  void seek(uint64 sample_index);
+  uint64 next_sample_index() const { return next_sample_index_; }
+
+  // Heart vector at a beat phase (2^-32 cycles), Q15 mV.
+  void heart_vector(uint32 phase, int32 *x, int32 *y, int32 *z) const;
+
+  // Render the next `count` samples: lead l of sample i goes to
+  // leads[l * lead_stride + i], in Q15 mV.
+  void render_block(int32 *leads, std::size_t count, std::size_t lead_stride);
+
+private:
+  Fixed_engine_config config_;
+  uint64 next_sample_index_{0U};
+  uint64 phase_{0U};
+};
+
+#endif // ECG_FIXED_POINT_H
@@ -0,0 +1,136 @@
+#include "ECGFixedPoint.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+// Rule 151: Avoid magic numbers.
+const float64 seconds_per_minute = 60.0;
+const float64 zero_tolerance = 1e-9;
+const float64 phase_units_32 = 4294967296.0;            // 2^32
+const float64 phase_units_64 = 18446744073709551616.0; // 2^64
+const float64 max_phase_32 = phase_units_32 - 1.0;
+
+int32 to_q15(float64 mv) {
+  const float64 scaled = std::nearbyint(std::ldexp(mv, q15_shift));
+  const float64 limit =
+      static_cast<float64>(std::numeric_limits<int32>::max());
+  return static_cast<int32>(std::max(-limit, std::min(scaled, limit)));
+}
+
+int32 to_q31(float64 unit) {
+  const float64 scaled = std::nearbyint(std::ldexp(unit, q31_shift));
+  const float64 limit =
+      static_cast<float64>(std::numeric_limits<int32>::max());
+  return static_cast<int32>(std::max(-limit, std::min(scaled, limit)));
+}
+
+// Table position per 2^-32 cycle for a Gaussian of the given width (in
+// 2^-32 cycles), scaled by 2^16 for the fractional table index.
+uint32 table_scale(float64 width_phase) {
+  if (width_phase <= 0.0) {
+    return std::numeric_limits<uint32>::max();
+  }
+  const float64 scale = phase_units_32 *
+                        static_cast<float64>(gaussian_table_intervals) /
+                        (static_cast<float64>(gaussian_table_range) *
+                         width_phase);
+  return (scale >= max_phase_32) ? std::numeric_limits<uint32>::max()
+                                 : static_cast<uint32>(std::nearbyint(scale));
+}
+
+// Adds the Gaussians of one component. `centers`, `widths` and `factors`
+// describe each Gaussian relative to the component, as in ECGMorphology.cpp.
+bool add_component(const Ecg_component &component, float64 cycle_s,
+                   const float64 *centers, const float64 *widths,
+                   const float64 *factors, std::size_t count,
+                   bool asymmetric, Fixed_engine_config *config) {
+  if (!component.is_active || component.duration_s <= zero_tolerance ||
+      component.start_time_s < 0.0 || component.start_time_s >= cycle_s) {
+    return true; // never visible within a beat
+  }
+  if (config->gaussian_count + count > max_fixed_gaussians) {
+    return false;
+  }
+
+  // The floating-point engine includes both ends of the component; rounding
+  // the start down and the end up keeps every sample it includes.
+  const float64 start = std::floor(component.start_time_s / cycle_s *
+                                   phase_units_32);
+  const float64 end = std::min(
+      std::ceil((component.start_time_s + component.duration_s) / cycle_s *
+                phase_units_32),
+      max_phase_32);
+  const float64 duration_phase =
+      component.duration_s / cycle_s * phase_units_32;
+
+  const Gaussian_shape_params &shape = component.shape_params;
+  for (std::size_t i = 0; i < count; ++i) {
+    float64 left_width = widths[i];
+    float64 right_width = widths[i];
+    if (asymmetric && shape.asymmetry > 0.0) {
+      right_width *= 1.0 + shape.asymmetry;
+    } else if (asymmetric && shape.asymmetry < 0.0) {
+      left_width *= 1.0 - shape.asymmetry;
+    }
+
+    Fixed_gaussian &g = config->gaussians[config->gaussian_count++];
+    g.start_phase = static_cast<uint32>(start);
+    g.duration_phase = static_cast<uint32>(end - start);
+    g.center_phase = static_cast<uint32>(std::nearbyint(
+        std::min(centers[i] * duration_phase, max_phase_32)));
+    g.left_scale = table_scale(left_width * duration_phase);
+    g.right_scale = table_scale(right_width * duration_phase);
+    const float64 amplitude = shape.scale * factors[i];
+    g.amplitude_x = to_q15(shape.direction.x * amplitude);
+    g.amplitude_y = to_q15(shape.direction.y * amplitude);
+    g.amplitude_z = to_q15(shape.direction.z * amplitude);
+  }
+  return true;
+}
+} // namespace
+
+bool make_fixed_engine_config(const Ecg_morphology &morphology,
+                              float64 heart_rate_bpm, float64 sampling_rate_hz,
+                              const Lead_matrix &lead_matrix,
+                              Fixed_engine_config *config) {
+  if (heart_rate_bpm <= zero_tolerance || sampling_rate_hz <= zero_tolerance) {
+    return false;
+  }
+  const float64 cycle_s = seconds_per_minute / heart_rate_bpm;
+  const float64 cycles_per_sample = 1.0 / (sampling_rate_hz * cycle_s);
+  if (cycles_per_sample >= 1.0) {
+    return false;
+  }
+
+  Fixed_engine_config result{};
+  result.gaussian_count = 0U;
+  result.phase_increment =
+      static_cast<uint64>(cycles_per_sample * phase_units_64);
+
+  const float64 p_center = morphology.p_wave.shape_params.center;
+  const float64 p_width = morphology.p_wave.shape_params.width;
+  const float64 t_center = morphology.t_wave.shape_params.center;
+  const float64 t_width = morphology.t_wave.shape_params.width;
+  const float64 single_factor = 1.0;
+  if (!add_component(morphology.p_wave, cycle_s, &p_center, &p_width,
+                     &single_factor, 1U, true, &result) ||
+      !add_component(morphology.qrs_complex, cycle_s, qrs_wave_centers,
+                     qrs_wave_widths, qrs_wave_scale_factors, qrs_wave_count,
+                     false, &result) ||
+      !add_component(morphology.t_wave, cycle_s, &t_center, &t_width,
+                     &single_factor, 1U, true, &result)) {
+    return false;
+  }
+
+  for (std::size_t lead = 0; lead < lead_matrix.lead_count(); ++lead) {
+    const Heart_vector direction = lead_matrix.direction(lead);
+    result.lead_x.push_back(to_q31(direction.x));
+    result.lead_y.push_back(to_q31(direction.y));
+    result.lead_z.push_back(to_q31(direction.z));
+  }
+
+  *config = result;
+  return true;
+}
@@ -0,0 +1,182 @@
+// Tests of the fixed-point engine (ecg_fixed_tests): integer output must be
+// reproducible bit for bit, and must follow the floating-point engine within
+// fixed_point_max_error_mv.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "ECGFixedPoint.h"
+#include "ECGSimulation.h"
+
+namespace
+{
+
+// FNV-1a over the bytes of the samples, least significant byte first.
+uint64 hash_samples(const std::vector<int32> &samples)
+{
+    uint64 hash = 14695981039346656037ULL;
+    for (const int32 sample : samples)
+    {
+        const uint32 bits = static_cast<uint32>(sample);
+        for (int32 byte = 0; byte < 4; ++byte)
+        {
+            hash ^= (bits >> (8 * byte)) & 0xFFU;
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+// True when sample `index` lies within `margin` (2^-32 cycles) of a point
+// where the waveform is discontinuous: a component edge or the beat
+// boundary. There the two engines' different phase rounding can legitimately
+// switch a component on in one and off in the other.
+bool near_discontinuity(const Fixed_engine_config &config, uint64 index, uint32 margin)
+{
+    const uint32 phase = static_cast<uint32>((index * config.phase_increment) >> 32);
+    const auto near = [phase, margin](uint32 edge) {
+        const uint32 ahead = phase - edge;
+        const uint32 behind = edge - phase;
+        return std::min(ahead, behind) <= margin;
+    };
+    if (near(0U))
+    {
+        return true;
+    }
+    for (std::size_t g = 0; g < config.gaussian_count; ++g)
+    {
+        const Fixed_gaussian &gaussian = config.gaussians[g];
+        if (near(gaussian.start_phase) || near(gaussian.start_phase + gaussian.duration_phase))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+Fixed_point_engine make_engine(const Ecg_morphology &morphology, float64 heart_rate_bpm, float64 sampling_rate_hz)
+{
+    Fixed_engine_config config{};
+    EXPECT_TRUE(make_fixed_engine_config(morphology, heart_rate_bpm, sampling_rate_hz, Lead_matrix::standard_12(),
+                                         &config));
+    return Fixed_point_engine(config);
+}
+
+} // namespace
+
+TEST(FixedPoint, GaussianTableFollowsExp)
+{
+    const float64 steps_per_unit =
+        static_cast<float64>(gaussian_table_intervals) / static_cast<float64>(gaussian_table_range);
+    for (uint64 position = 0U; position < (uint64{gaussian_table_intervals} << 16); position += 977U)
+    {
+        const float64 x = static_cast<float64>(position) / 65536.0 / steps_per_unit;
+        const float64 expected = std::exp(-(x * x)) * 32768.0;
+        EXPECT_LE(std::abs(static_cast<float64>(fixed_gaussian(position)) - expected), 1.5) << "x = " << x;
+    }
+    EXPECT_EQ(fixed_gaussian(0U), 32767);
+    EXPECT_EQ(fixed_gaussian(uint64{gaussian_table_intervals} << 16), 0);
+}
+
+TEST(FixedPoint, FollowsFloatingPointEngine)
+{
+    struct Case
+    {
+        float64 pr, qrs, axis, asymmetry, heart_rate, sampling_rate;
+    };
+    const Case cases[] = {
+        {0.16, 0.10, 60.0, 0.0, 72.0, 500.0},
+        {0.20, 0.08, -30.0, 0.8, 45.0, 250.0},
+        {0.12, 0.12, 110.0, -0.4, 170.0, 1000.0},
+    };
+
+    for (const Case &c : cases)
+    {
+        Ecg_morphology morphology = create_normal_sinus_morphology(c.pr, c.qrs, c.axis);
+        morphology.t_wave.shape_params.asymmetry = c.asymmetry;
+
+        ECGSimulationEngine reference(morphology, c.heart_rate, c.sampling_rate);
+        const std::vector<Lead_sample> expected = reference.generate(6.0);
+
+        Fixed_engine_config config{};
+        ASSERT_TRUE(make_fixed_engine_config(morphology, c.heart_rate, c.sampling_rate, Lead_matrix::standard_12(),
+                                             &config));
+        Fixed_point_engine engine(config);
+        const std::size_t count = expected.size();
+        std::vector<int32> leads(count * standard_lead_count);
+        engine.render_block(leads.data(), count, count);
+
+        // These rates put samples exactly on component edges and beat
+        // boundaries; those few samples are excluded from the bound.
+        const uint32 edge_margin = 16U;
+        float64 max_error = 0.0;
+        std::size_t skipped = 0U;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (near_discontinuity(config, i, edge_margin))
+            {
+                ++skipped;
+                continue;
+            }
+            for (std::size_t lead = 0; lead < standard_lead_count; ++lead)
+            {
+                const float64 error = std::abs(fixed_to_mv(leads[(lead * count) + i]) - expected[i].leads[lead]);
+                max_error = std::max(max_error, error);
+            }
+        }
+        EXPECT_LE(skipped, count / 100U);
+        std::printf("[fixed-point] hr %.0f rate %.0f: max error %.3e mV (%zu edge samples skipped)\n", c.heart_rate,
+                    c.sampling_rate, max_error, skipped);
+        EXPECT_LE(max_error, fixed_point_max_error_mv);
+    }
+}
+
+TEST(FixedPoint, OutputIsBitExact)
+{
+    // Golden hash of 5000 samples x 12 leads. Rendering is integer only, so
+    // a given Fixed_engine_config yields the same samples on every platform;
+    // a change here means the fixed-point output changed.
+    Fixed_point_engine engine = make_engine(create_normal_sinus_morphology(0.16, 0.10, 60.0), 72.0, 500.0);
+    const std::size_t count = 5000U;
+    std::vector<int32> leads(count * standard_lead_count);
+    engine.render_block(leads.data(), count, count);
+    EXPECT_EQ(hash_samples(leads), 0xe83f259f1c04126bULL);
+}
+
+TEST(FixedPoint, SeekMatchesContinuousRendering)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    Fixed_point_engine continuous = make_engine(morphology, 83.0, 360.0);
+    Fixed_point_engine seeking = make_engine(morphology, 83.0, 360.0);
+
+    const std::size_t count = 1000U;
+    std::vector<int32> all(count * standard_lead_count);
+    continuous.render_block(all.data(), count, count);
+
+    const std::size_t start = 613U;
+    seeking.seek(start);
+    std::vector<int32> tail((count - start) * standard_lead_count);
+    seeking.render_block(tail.data(), count - start, count - start);
+    EXPECT_EQ(seeking.next_sample_index(), count);
+
+    for (std::size_t lead = 0; lead < standard_lead_count; ++lead)
+    {
+        for (std::size_t i = start; i < count; ++i)
+        {
+            ASSERT_EQ(tail[(lead * (count - start)) + (i - start)], all[(lead * count) + i]);
+        }
+    }
+}
+
+TEST(FixedPoint, RejectsInvalidRates)
+{
+    Fixed_engine_config config{};
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    EXPECT_FALSE(make_fixed_engine_config(morphology, 0.0, 500.0, Lead_matrix::standard_12(), &config));
+    EXPECT_FALSE(make_fixed_engine_config(morphology, 72.0, -1.0, Lead_matrix::standard_12(), &config));
+    EXPECT_FALSE(make_fixed_engine_config(morphology, 6000.0, 50.0, Lead_matrix::standard_12(), &config));
+}
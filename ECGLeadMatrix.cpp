@@ -0,0 +1,183 @@
+#include "ECGLeadMatrix.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+// Rule 151: Avoid magic numbers.
+const float64 zero_tolerance = 1e-9;
+const float64 unit_length_tolerance = 1e-15;
+
+// Samples per cache tile: 3 x 512 x 8 B = 12 KB of heart vector components
+// stay in L1 while every lead group sweeps over them.
+const std::size_t projection_tile_samples = 512U;
+
+// Leads computed together: each heart vector load feeds this many outputs.
+const std::size_t leads_per_group = 4U;
+
+// --- Minimal SIMD layer: the widest double vector the target enables. ---
+#if defined(__AVX__)
+typedef __m256d Simd_vector;
+const std::size_t simd_width = 4U;
+inline Simd_vector simd_load(const float64 *p) { return _mm256_loadu_pd(p); }
+inline void simd_store(float64 *p, Simd_vector v) { _mm256_storeu_pd(p, v); }
+inline Simd_vector simd_broadcast(float64 v) { return _mm256_set1_pd(v); }
+inline Simd_vector simd_add(Simd_vector a, Simd_vector b) {
+  return _mm256_add_pd(a, b);
+}
+inline Simd_vector simd_mul(Simd_vector a, Simd_vector b) {
+  return _mm256_mul_pd(a, b);
+}
+#elif defined(__SSE2__)
+typedef __m128d Simd_vector;
+const std::size_t simd_width = 2U;
+inline Simd_vector simd_load(const float64 *p) { return _mm_loadu_pd(p); }
+inline void simd_store(float64 *p, Simd_vector v) { _mm_storeu_pd(p, v); }
+inline Simd_vector simd_broadcast(float64 v) { return _mm_set1_pd(v); }
+inline Simd_vector simd_add(Simd_vector a, Simd_vector b) {
+  return _mm_add_pd(a, b);
+}
+inline Simd_vector simd_mul(Simd_vector a, Simd_vector b) {
+  return _mm_mul_pd(a, b);
+}
+#endif
+
+// Projects samples [begin, end) onto `Group` consecutive leads. The
+// operation order (x + y) + z matches project_to_lead(), so results are
+// bit-identical to the per-sample path.
+template <std::size_t Group>
+void project_lead_group(const float64 *hx, const float64 *hy,
+                        const float64 *hz, std::size_t begin, std::size_t end,
+                        const float64 *ax, const float64 *ay,
+                        const float64 *az, float64 *out,
+                        std::size_t out_stride) {
+  std::size_t i = begin;
+
+#if defined(__AVX__) || defined(__SSE2__)
+  Simd_vector vx[Group];
+  Simd_vector vy[Group];
+  Simd_vector vz[Group];
+  for (std::size_t g = 0; g < Group; ++g) {
+    vx[g] = simd_broadcast(ax[g]);
+    vy[g] = simd_broadcast(ay[g]);
+    vz[g] = simd_broadcast(az[g]);
+  }
+  for (; i + simd_width <= end; i += simd_width) {
+    const Simd_vector x = simd_load(hx + i);
+    const Simd_vector y = simd_load(hy + i);
+    const Simd_vector z = simd_load(hz + i);
+    for (std::size_t g = 0; g < Group; ++g) {
+      const Simd_vector sum =
+          simd_add(simd_add(simd_mul(x, vx[g]), simd_mul(y, vy[g])),
+                   simd_mul(z, vz[g]));
+      simd_store(out + (g * out_stride) + i, sum);
+    }
+  }
+#endif
+
+  for (; i < end; ++i) {
+    for (std::size_t g = 0; g < Group; ++g) {
+      out[(g * out_stride) + i] =
+          (hx[i] * ax[g]) + (hy[i] * ay[g]) + (hz[i] * az[g]);
+    }
+  }
+}
+} // namespace
+
+Lead_matrix Lead_matrix::standard_12() {
+  Lead_matrix matrix;
+  matrix.add_lead("lead_I", Standard_leads::lead_i);
+  matrix.add_lead("lead_II", Standard_leads::lead_ii);
+  matrix.add_lead("lead_III", Standard_leads::lead_iii);
+  matrix.add_lead("aVR", Standard_leads::lead_avr);
+  matrix.add_lead("aVL", Standard_leads::lead_avl);
+  matrix.add_lead("aVF", Standard_leads::lead_avf);
+  matrix.add_lead("V1", Standard_leads::lead_v1);
+  matrix.add_lead("V2", Standard_leads::lead_v2);
+  matrix.add_lead("V3", Standard_leads::lead_v3);
+  matrix.add_lead("V4", Standard_leads::lead_v4);
+  matrix.add_lead("V5", Standard_leads::lead_v5);
+  matrix.add_lead("V6", Standard_leads::lead_v6);
+  return matrix;
+}
+
+bool Lead_matrix::add_lead(const std::string &name,
+                           const Heart_vector &direction) {
+  const float64 magnitude =
+      std::sqrt(dot_product(direction, direction));
+  if (magnitude <= zero_tolerance) {
+    return false;
+  }
+  // The standard leads are already unit vectors; normalizing them again
+  // could change the last bit, so leave unit vectors untouched.
+  const Heart_vector unit =
+      (std::abs(magnitude - 1.0) <= unit_length_tolerance)
+          ? direction
+          : normalize(direction);
+  names_.push_back(name);
+  axis_x_.push_back(unit.x);
+  axis_y_.push_back(unit.y);
+  axis_z_.push_back(unit.z);
+  return true;
+}
+
+bool Lead_matrix::load(const std::string &path) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  Lead_matrix loaded;
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    std::string name;
+    if (!(fields >> name) || name[0] == '#') {
+      continue;
+    }
+    Heart_vector direction;
+    if (!(fields >> direction.x >> direction.y >> direction.z) ||
+        !loaded.add_lead(name, direction)) {
+      return false;
+    }
+  }
+  if (loaded.lead_count() == 0U) {
+    return false;
+  }
+
+  *this = loaded;
+  return true;
+}
+
+void Lead_matrix::project(const float64 *hx, const float64 *hy,
+                          const float64 *hz, std::size_t count, float64 *out,
+                          std::size_t out_stride) const {
+  const std::size_t lead_total = lead_count();
+  const float64 *ax = axis_x_.data();
+  const float64 *ay = axis_y_.data();
+  const float64 *az = axis_z_.data();
+
+  for (std::size_t begin = 0; begin < count;
+       begin += projection_tile_samples) {
+    const std::size_t end = (count - begin < projection_tile_samples)
+                                ? count
+                                : begin + projection_tile_samples;
+    std::size_t lead = 0;
+    for (; lead + leads_per_group <= lead_total; lead += leads_per_group) {
+      project_lead_group<leads_per_group>(hx, hy, hz, begin, end, ax + lead,
+                                          ay + lead, az + lead,
+                                          out + (lead * out_stride),
+                                          out_stride);
+    }
+    for (; lead < lead_total; ++lead) {
+      project_lead_group<1U>(hx, hy, hz, begin, end, ax + lead, ay + lead,
+                             az + lead, out + (lead * out_stride),
+                             out_stride);
+    }
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef ECG_LEAD_MATRIX_H
+#define ECG_LEAD_MATRIX_H
+
+#include "ECGMath.h"
+#include "Types.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A configurable set of N lead (electrode) unit vectors.
+ *
+ * Projection of a block of heart vectors onto all N leads is the 3 x N by
+ * 3 x samples product computed by project(). The standard 12-lead ECG is
+ * the standard_12() preset; body-surface maps with hundreds of electrodes
+ * are loaded from a file or built with add_lead().
+ */
+class Lead_matrix {
+public:
+  Lead_matrix() = default;
+
+  // The 12 Standard_leads vectors, in Lead_index order.
+  static Lead_matrix standard_12();
+
+  // Append a lead; the direction is normalized. Returns false for a
+  // zero-length direction.
+  bool add_lead(const std::string &name, const Heart_vector &direction);
+
+  // Replace the matrix with leads read from a text file, one lead per line:
+  //   <name> <x> <y> <z>
+  // Blank lines and lines starting with '#' are ignored. On failure the
+  // matrix is left unchanged.
+  bool load(const std::string &path);
+
+  std::size_t lead_count() const { return names_.size(); }
+  const std::string &name(std::size_t lead) const { return names_[lead]; }
+  Heart_vector direction(std::size_t lead) const {
+    return {axis_x_[lead], axis_y_[lead], axis_z_[lead]};
+  }
+
+  // out[lead * out_stride + i] = dot(heart_i, direction(lead)) for every
+  // lead and every i < count. The inputs are the heart vector components,
+  // one array per axis.
+  void project(const float64 *hx, const float64 *hy, const float64 *hz,
+               std::size_t count, float64 *out, std::size_t out_stride) const;
+
+private:
+  std::vector<std::string> names_;
+  // Lead directions stored per axis so a group of leads loads contiguously.
+  std::vector<float64> axis_x_;
+  std::vector<float64> axis_y_;
+  std::vector<float64> axis_z_;
+};
+
+#endif // ECG_LEAD_MATRIX_H
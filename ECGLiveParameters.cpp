@@ -0,0 +1,42 @@
+#include "ECGLiveParameters.h"
+
+#include <cstring>
+
+void Parameter_channel::publish(const Live_parameters &parameters) {
+  std::array<uint64, word_count> buffer{};
+  std::memcpy(buffer.data(), &parameters, sizeof(parameters));
+
+  std::lock_guard<std::mutex> lock(writer_mutex_);
+  const uint64 sequence = sequence_.load(std::memory_order_relaxed);
+  sequence_.store(sequence + 1U, std::memory_order_relaxed);
+  // Readers that see any of the new words also see the odd sequence.
+  std::atomic_thread_fence(std::memory_order_release);
+  for (std::size_t i = 0; i < word_count; ++i) {
+    words_[i].store(buffer[i], std::memory_order_relaxed);
+  }
+  sequence_.store(sequence + 2U, std::memory_order_release);
+}
+
+bool Parameter_channel::poll(uint64 *seen_version, Live_parameters *out) const {
+  const uint64 before = sequence_.load(std::memory_order_acquire);
+  if ((before & 1U) != 0U || (before / 2U) == *seen_version) {
+    return false; // being written, or nothing new
+  }
+
+  std::array<uint64, word_count> buffer{};
+  for (std::size_t i = 0; i < word_count; ++i) {
+    buffer[i] = words_[i].load(std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (sequence_.load(std::memory_order_relaxed) != before) {
+    return false; // torn; the next poll picks up the newer snapshot
+  }
+
+  std::memcpy(out, buffer.data(), sizeof(*out));
+  *seen_version = before / 2U;
+  return true;
+}
+
+uint64 Parameter_channel::version() const {
+  return sequence_.load(std::memory_order_acquire) / 2U;
+}
@@ -0,0 +1,57 @@
+#ifndef ECG_LIVE_PARAMETERS_H
+#define ECG_LIVE_PARAMETERS_H
+
+#include "ECGMorphology.h"
+#include "Types.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <type_traits>
+
+// Parameters that can change while a record is being generated.
+struct Live_parameters {
+  Ecg_morphology morphology;
+  float64 heart_rate_bpm;
+  float64 noise_gain; // multiplies the sum of all noise sources
+};
+
+/**
+ * @brief Publishes Live_parameters snapshots from control threads to a
+ * generating engine without locking the generation path.
+ *
+ * A seqlock: publish() makes the sequence number odd, stores the snapshot
+ * as atomic words and makes it even again. poll() copies the words and
+ * accepts the copy only if the sequence number was even and unchanged
+ * across the copy. poll() is wait-free: instead of retrying a torn read it
+ * reports no update, and the engine polls again at the next beat. Writers
+ * are serialized with a mutex, which only control threads ever take.
+ */
+class Parameter_channel {
+public:
+  Parameter_channel() = default;
+  Parameter_channel(const Parameter_channel &) = delete;
+  Parameter_channel &operator=(const Parameter_channel &) = delete;
+
+  void publish(const Live_parameters &parameters);
+
+  // If a snapshot newer than `*seen_version` is available, copy it to `out`,
+  // update `*seen_version` and return true.
+  bool poll(uint64 *seen_version, Live_parameters *out) const;
+
+  // Number of snapshots published so far.
+  uint64 version() const;
+
+private:
+  static_assert(std::is_trivially_copyable<Live_parameters>::value,
+                "snapshots are copied word by word");
+  static const std::size_t word_count =
+      (sizeof(Live_parameters) + sizeof(uint64) - 1U) / sizeof(uint64);
+
+  std::atomic<uint64> sequence_{0U};
+  std::array<std::atomic<uint64>, word_count> words_{};
+  std::mutex writer_mutex_;
+};
+
+#endif // ECG_LIVE_PARAMETERS_H
@@ -1,12 +1,32 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include "ECGAdc.h"
+#include "ECGArchive.h"
+#include "ECGCore.h"
+#include "ECGCheckpoint.h"
+#include "ECGFft.h"
+#include "ECGLeadMatrix.h"
+#include "ECGLiveParameters.h"
 #include "ECGMath.h"
 #include "ECGMorphology.h"
+#include "ECGPipeline.h"
 #include "ECGSimulation.h"
+#include "ECGSpectralNoise.h"
+#include "NoiseGenerator.h"
 
 TEST(HeartVectorMath, Addition)
 {
@@ -97,3 +117,1293 @@ TEST(ECGSimulation, GoldenNormalSinus60Bpm500Hz)
         }
     }
 }
+
+
+TEST(ECGSimulation, BlockPathMatchesPerSamplePath)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    ECGSimulationEngine reference(morphology, 72.0, 500.0);
+    ECGSimulationEngine streaming(morphology, 72.0, 500.0);
+    reference.add_noise_source(std::make_shared<MainsHumGenerator>(0.05));
+    streaming.add_noise_source(std::make_shared<MainsHumGenerator>(0.05));
+
+    const std::vector<Lead_sample> expected = reference.generate(3.0);
+    ASSERT_EQ(streaming.sample_count(3.0), expected.size());
+
+    Sample_block block{};
+    allocate_sample_block(&block, 256U, standard_lead_count);
+
+    std::size_t index = 0U;
+    while (index < expected.size())
+    {
+        const std::size_t n = streaming.generate_block(&block, expected.size() - index);
+        ASSERT_GT(n, 0U);
+        for (std::size_t i = 0; i < n; ++i, ++index)
+        {
+            EXPECT_EQ(block.time_s[i], expected[index].time_s);
+            for (std::size_t lead = 0; lead < standard_lead_count; ++lead)
+            {
+                EXPECT_EQ(lead_column(&block, lead)[i], expected[index].leads[lead]);
+            }
+        }
+    }
+}
+
+TEST(ECGPipeline, StreamsEverySampleInOrder)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    ECGSimulationEngine reference(morphology, 72.0, 500.0);
+    ECGSimulationEngine streaming(morphology, 72.0, 500.0);
+    reference.add_noise_source(std::make_shared<BaselineWanderGenerator>(0.1));
+    streaming.add_noise_source(std::make_shared<BaselineWanderGenerator>(0.1));
+
+    const std::vector<Lead_sample> expected = reference.generate(5.0);
+
+    Pipeline_config config;
+    config.block_samples = 100U;
+    config.block_count = 3U;
+    ECGPipeline pipeline(&streaming, config);
+
+    bool post_ran = false;
+    pipeline.set_post_processor([&post_ran](Sample_block *) { post_ran = true; return true; });
+
+    std::size_t index = 0U;
+    bool matches = true;
+    pipeline.set_sink([&](Sample_block *block) {
+        for (std::size_t i = 0; i < block->count; ++i, ++index)
+        {
+            matches = matches && (index < expected.size()) &&
+                      (block->time_s[i] == expected[index].time_s) &&
+                      (lead_column(block, lead_ii_index)[i] == expected[index].leads[lead_ii_index]);
+        }
+        return true;
+    });
+
+    ASSERT_TRUE(pipeline.run(expected.size()));
+    EXPECT_TRUE(post_ran);
+    EXPECT_TRUE(matches);
+    EXPECT_EQ(index, expected.size());
+
+    ASSERT_EQ(pipeline.stats().size(), 4U);
+    for (const auto &stat : pipeline.stats())
+    {
+        EXPECT_EQ(stat.samples, expected.size());
+        EXPECT_GE(stat.utilization(), 0.0);
+        EXPECT_LE(stat.utilization(), 1.0);
+    }
+}
+
+TEST(ECGPipeline, FailingSinkAbortsRun)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    ECGSimulationEngine engine(morphology, 72.0, 500.0);
+
+    Pipeline_config config;
+    config.block_samples = 64U;
+    config.block_count = 2U;
+    ECGPipeline pipeline(&engine, config);
+    pipeline.set_sink([](Sample_block *) { return false; });
+
+    EXPECT_FALSE(pipeline.run(10000U));
+}
+
+TEST(ECGPipeline, FollowsEngineChangesAfterConstruction)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    ECGSimulationEngine engine(morphology, 72.0, 500.0);
+    Pipeline_config config;
+    config.block_samples = 128U;
+    config.block_count = 2U;
+    ECGPipeline pipeline(&engine, config);
+
+    // An ADC stage and a different lead matrix, both added after the
+    // pipeline sized its blocks.
+    Lead_matrix limb;
+    ASSERT_TRUE(limb.add_lead("I", Standard_leads::lead_i));
+    ASSERT_TRUE(limb.add_lead("II", Standard_leads::lead_ii));
+    engine.set_lead_matrix(limb);
+    Adc_config adc;
+    adc.resolution_bits = 16;
+    ASSERT_TRUE(engine.set_adc(adc));
+
+    uint64 samples = 0U;
+    bool quantized = true;
+    pipeline.set_sink([&](Sample_block *block) {
+        samples += block->count;
+        quantized = quantized && (block->lead_count == 2U) && (block->adc.count == block->count) &&
+                    (block->adc.codes16.size() == 2U * block->capacity);
+        return true;
+    });
+    ASSERT_TRUE(pipeline.run(1000U));
+    EXPECT_EQ(samples, 1000U);
+    EXPECT_TRUE(quantized);
+}
+
+TEST(ECGPipeline, RejectedRenderFailsRun)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    ECGSimulationEngine engine(morphology, 0.0, 500.0); // no valid beat
+    ECGPipeline pipeline(&engine, Pipeline_config());
+    uint64 samples = 0U;
+    pipeline.set_sink([&samples](Sample_block *block) {
+        samples += block->count;
+        return true;
+    });
+
+    EXPECT_FALSE(pipeline.run(1000U));
+    EXPECT_EQ(samples, 0U);
+    EXPECT_TRUE(pipeline.run(0U)); // nothing due, nothing rendered
+}
+
+TEST(ECGArchive, WindowReadMatchesStreamedRecord)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    ECGSimulationEngine reference(morphology, 72.0, 500.0);
+    ECGSimulationEngine streaming(morphology, 72.0, 500.0);
+    const std::vector<Lead_sample> expected = reference.generate(20.0);
+
+    // Blocks deliberately do not line up with chunks.
+    const std::string path = testing::TempDir() + "ecg_archive_test.bin";
+    Archive_writer writer;
+    ASSERT_TRUE(writer.open(path, standard_lead_count, 500.0, 1000U, true));
+    Sample_block block{};
+    allocate_sample_block(&block, 333U, standard_lead_count);
+    std::size_t written = 0U;
+    while (written < expected.size())
+    {
+        written += streaming.render_block(&block, expected.size() - written);
+        ASSERT_TRUE(writer.append(&block));
+    }
+    ASSERT_TRUE(writer.close());
+
+    Archive_reader reader;
+    ASSERT_TRUE(reader.open(path));
+    EXPECT_EQ(reader.total_samples(), expected.size());
+    EXPECT_EQ(reader.chunk_count(), 11U);
+
+    // 1.5 s window straddling chunk boundaries, two leads in custom order.
+    const std::vector<std::size_t> leads = {lead_v6_index, lead_ii_index};
+    Archive_window window;
+    ASSERT_TRUE(reader.read_window(7.5, 9.0, leads, &window));
+    ASSERT_EQ(window.count, 750U);
+    EXPECT_EQ(window.start_index, 3750U);
+    for (std::size_t i = 0; i < window.count; ++i)
+    {
+        const Lead_sample &sample = expected[window.start_index + i];
+        EXPECT_EQ(window.time_s[i], sample.time_s);
+        EXPECT_EQ(window.values[i], sample.leads[lead_v6_index]);
+        EXPECT_EQ(window.values[window.count + i], sample.leads[lead_ii_index]);
+    }
+
+    // Stats cover exactly the samples of their chunk.
+    const Archive_lead_stats *stats = reader.chunk_stats(2U, lead_ii_index);
+    ASSERT_NE(stats, nullptr);
+    float64 lo = expected[2000].leads[lead_ii_index];
+    float64 hi = lo;
+    for (std::size_t i = 2000U; i < 3000U; ++i)
+    {
+        lo = std::min(lo, expected[i].leads[lead_ii_index]);
+        hi = std::max(hi, expected[i].leads[lead_ii_index]);
+    }
+    EXPECT_EQ(stats->min, lo);
+    EXPECT_EQ(stats->max, hi);
+
+    // Reads past the end are clipped; bad lead indices are rejected.
+    ASSERT_TRUE(reader.read(expected.size() - 10U, 100U, leads, &window));
+    EXPECT_EQ(window.count, 10U);
+    EXPECT_FALSE(reader.read(0U, 10U, {standard_lead_count}, &window));
+
+    reader.close();
+    std::remove(path.c_str());
+}
+
+TEST(ECGArchive, RejectsInconsistentChunkEntries)
+{
+    ECGSimulationEngine engine(create_normal_sinus_morphology(0.16, 0.10, 60.0), 72.0, 500.0);
+    const std::string path = testing::TempDir() + "ecg_archive_entries.bin";
+    Archive_writer writer;
+    ASSERT_TRUE(writer.open(path, standard_lead_count, 500.0, 100U, false));
+    Sample_block block{};
+    allocate_sample_block(&block, 250U, standard_lead_count);
+    engine.render_block(&block, 250U);
+    ASSERT_TRUE(writer.append(&block));
+    ASSERT_TRUE(writer.close());
+
+    std::vector<char> original;
+    {
+        std::ifstream in(path, std::ios::binary);
+        original.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    Archive_trailer trailer;
+    std::memcpy(&trailer, original.data() + original.size() - sizeof(trailer), sizeof(trailer));
+    ASSERT_EQ(trailer.chunk_count, 3U);
+
+    // Rewrite field `field` of entry `index` and check the file is refused.
+    const auto rejects = [&](std::size_t index, uint64 Archive_chunk_entry::*field, uint64 value) {
+        std::vector<char> bytes = original;
+        Archive_chunk_entry entry;
+        char *address = bytes.data() + trailer.footer_offset + (index * sizeof(entry));
+        std::memcpy(&entry, address, sizeof(entry));
+        entry.*field = value;
+        std::memcpy(address, &entry, sizeof(entry));
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+        Archive_reader reader;
+        return !reader.open(path);
+    };
+
+    const uint64 column_bytes = 100U * sizeof(float64);
+    EXPECT_TRUE(rejects(2U, &Archive_chunk_entry::offset, trailer.footer_offset));
+    EXPECT_TRUE(rejects(2U, &Archive_chunk_entry::offset, ~0ULL - 8U));
+    EXPECT_TRUE(rejects(0U, &Archive_chunk_entry::offset, trailer.footer_offset - column_bytes));
+    EXPECT_TRUE(rejects(1U, &Archive_chunk_entry::sample_count, 101U));
+    EXPECT_TRUE(rejects(1U, &Archive_chunk_entry::start_index, 0U));
+    EXPECT_TRUE(rejects(2U, &Archive_chunk_entry::start_index, ~0ULL - 10U));
+    EXPECT_TRUE(rejects(2U, &Archive_chunk_entry::sample_count, 0U));
+
+    // A header whose sampling rate cannot convert times is refused too.
+    for (const float64 rate : {0.0, -500.0, std::nan(""), std::numeric_limits<float64>::infinity()})
+    {
+        std::vector<char> bytes = original;
+        Archive_header header;
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        header.sampling_rate_hz = rate;
+        std::memcpy(bytes.data(), &header, sizeof(header));
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+        Archive_reader reader;
+        EXPECT_FALSE(reader.open(path)) << "rate " << rate;
+    }
+
+    // The untouched file still opens, and an enormous count is clipped
+    // instead of wrapping around.
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(original.data(), static_cast<std::streamsize>(original.size()));
+    }
+    Archive_reader reader;
+    ASSERT_TRUE(reader.open(path));
+    Archive_window window;
+    ASSERT_TRUE(reader.read(200U, ~0ULL, {lead_ii_index}, &window));
+    EXPECT_EQ(window.start_index, 200U);
+    EXPECT_EQ(window.count, 50U);
+
+    // Window times past anything a uint64 can index are clipped too, and
+    // non-finite ones are refused.
+    ASSERT_TRUE(reader.read_window(0.45, 1e300, {lead_ii_index}, &window));
+    EXPECT_EQ(window.start_index, 225U);
+    EXPECT_EQ(window.count, 25U);
+    ASSERT_TRUE(reader.read_window(1e300, 2e300, {lead_ii_index}, &window));
+    EXPECT_EQ(window.count, 0U);
+    const float64 infinity = std::numeric_limits<float64>::infinity();
+    EXPECT_FALSE(reader.read_window(0.0, infinity, {lead_ii_index}, &window));
+    EXPECT_FALSE(reader.read_window(std::nan(""), 0.1, {lead_ii_index}, &window));
+    EXPECT_EQ(window.count, 0U);
+    reader.close();
+    std::remove(path.c_str());
+}
+
+TEST(ECGCheckpoint, RestoredEngineContinuesBitIdentically)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    ECGSimulationEngine original(morphology, 72.0, 500.0);
+    original.add_noise_source(std::make_shared<WhiteNoiseGenerator>(0.05, 1234U));
+    original.add_noise_source(std::make_shared<BaselineWanderGenerator>(0.1));
+
+    Sample_block block{};
+    allocate_sample_block(&block, 500U, standard_lead_count);
+    for (int32 i = 0; i < 7; ++i)
+    {
+        original.generate_block(&block, block.capacity);
+    }
+
+    std::vector<uint8> state;
+    Checkpoint_writer writer(&state);
+    original.save_state(&writer);
+
+    // Same configuration but a different seed and morphology: everything
+    // must come from the checkpoint.
+    ECGSimulationEngine restored(create_normal_sinus_morphology(0.2, 0.08, 0.0), 90.0, 500.0);
+    restored.add_noise_source(std::make_shared<WhiteNoiseGenerator>(0.01, 99U));
+    restored.add_noise_source(std::make_shared<BaselineWanderGenerator>(0.3));
+    Checkpoint_reader reader(state.data(), state.size());
+    ASSERT_TRUE(restored.restore_state(&reader));
+    EXPECT_EQ(reader.remaining(), 0U);
+    EXPECT_EQ(restored.next_sample_index(), original.next_sample_index());
+
+    Sample_block expected{};
+    allocate_sample_block(&expected, 500U, standard_lead_count);
+    for (int32 i = 0; i < 3; ++i)
+    {
+        original.generate_block(&expected, expected.capacity);
+        restored.generate_block(&block, block.capacity);
+        EXPECT_EQ(block.start_index, expected.start_index);
+        EXPECT_TRUE(expected.values == block.values);
+    }
+
+    // A mismatched noise configuration is rejected.
+    ECGSimulationEngine mismatched(morphology, 72.0, 500.0);
+    Checkpoint_reader again(state.data(), state.size());
+    EXPECT_FALSE(mismatched.restore_state(&again));
+}
+
+TEST(ECGCheckpoint, FailedRestoreLeavesEngineUnchanged)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    const auto make_engine = [&morphology](uint64 seed) {
+        std::unique_ptr<ECGSimulationEngine> engine(new ECGSimulationEngine(morphology, 72.0, 500.0));
+        engine->add_noise_source(std::make_shared<WhiteNoiseGenerator>(0.05, seed));
+        engine->add_noise_source(
+            std::make_shared<SpectralNoiseGenerator>(create_colored_noise_config(1.0, 0.02), 500.0));
+        Adc_config adc;
+        adc.resolution_bits = 16;
+        adc.dither = true;
+        adc.dither_seed = seed;
+        EXPECT_TRUE(engine->set_adc(adc));
+        return engine;
+    };
+    Sample_block block{};
+    allocate_sample_block(&block, 250U, standard_lead_count);
+    allocate_adc_block(&block.adc, 250U, standard_lead_count, 16);
+
+    std::unique_ptr<ECGSimulationEngine> source = make_engine(1U);
+    source->generate_block(&block, block.capacity);
+    std::vector<uint8> record;
+    Checkpoint_writer record_writer(&record);
+    source->save_state(&record_writer);
+
+    // The record is cut inside the ADC state: every noise source has been
+    // restored by the time that is noticed.
+    std::unique_ptr<ECGSimulationEngine> target = make_engine(2U);
+    std::unique_ptr<ECGSimulationEngine> untouched = make_engine(2U);
+    for (int32 i = 0; i < 2; ++i)
+    {
+        target->generate_block(&block, block.capacity);
+        untouched->generate_block(&block, block.capacity);
+    }
+    std::vector<uint8> before;
+    Checkpoint_writer before_writer(&before);
+    target->save_state(&before_writer);
+
+    Checkpoint_reader reader(record.data(), record.size() - 4U);
+    EXPECT_FALSE(target->restore_state(&reader));
+    std::vector<uint8> after;
+    Checkpoint_writer after_writer(&after);
+    target->save_state(&after_writer);
+    EXPECT_TRUE(before == after);
+
+    Sample_block expected{};
+    allocate_sample_block(&expected, 250U, standard_lead_count);
+    allocate_adc_block(&expected.adc, 250U, standard_lead_count, 16);
+    target->generate_block(&block, block.capacity);
+    untouched->generate_block(&expected, expected.capacity);
+    EXPECT_TRUE(block.values == expected.values);
+    EXPECT_TRUE(block.adc.codes16 == expected.adc.codes16);
+}
+
+TEST(ECGCheckpoint, PipelineCheckpointsResumeMidRun)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    const uint64 total = 10000U;
+
+    std::vector<float64> uninterrupted;
+    std::vector<std::vector<uint8>> checkpoints;
+    {
+        ECGSimulationEngine engine(morphology, 72.0, 500.0);
+        engine.add_noise_source(std::make_shared<WhiteNoiseGenerator>(0.05, 7U));
+        Pipeline_config config;
+        config.block_samples = 256U;
+        config.block_count = 4U;
+        config.checkpoint_interval_blocks = 10U;
+        ECGPipeline pipeline(&engine, config);
+        pipeline.set_sink([&uninterrupted](Sample_block *block) {
+            uninterrupted.insert(uninterrupted.end(), lead_column(block, lead_i_index),
+                                 lead_column(block, lead_i_index) + block->count);
+            return true;
+        });
+        pipeline.set_checkpoint_handler([&](const std::vector<uint8> &state) {
+            checkpoints.push_back(state);
+            return true;
+        });
+        ASSERT_TRUE(pipeline.run(total));
+    }
+    // Every 10 blocks of 256: after samples 2560, 5120, 7680 and 10000 (end).
+    ASSERT_EQ(checkpoints.size(), 4U);
+    const std::vector<uint8> &checkpoint = checkpoints[2];
+
+    ECGSimulationEngine resumed(morphology, 72.0, 500.0);
+    resumed.add_noise_source(std::make_shared<WhiteNoiseGenerator>(0.05, 8U));
+    Checkpoint_reader reader(checkpoint.data(), checkpoint.size());
+    ASSERT_TRUE(resumed.restore_state(&reader));
+    EXPECT_EQ(resumed.next_sample_index(), 30U * 256U);
+
+    std::vector<float64> tail;
+    ECGPipeline pipeline(&resumed, Pipeline_config());
+    pipeline.set_sink([&tail](Sample_block *block) {
+        tail.insert(tail.end(), lead_column(block, lead_i_index), lead_column(block, lead_i_index) + block->count);
+        return true;
+    });
+    ASSERT_TRUE(pipeline.run(total - resumed.next_sample_index()));
+    ASSERT_EQ(tail.size(), total - (30U * 256U));
+    EXPECT_TRUE(std::equal(tail.begin(), tail.end(), uninterrupted.begin() + (30 * 256)));
+}
+
+TEST(LeadMatrix, BlockedProjectionMatchesProjectToLead)
+{
+    // 250 electrodes on a sphere; an odd count exercises the remainder paths.
+    Lead_matrix matrix;
+    for (int32 e = 0; e < 250; ++e)
+    {
+        const float64 polar = std::acos(1.0 - (2.0 * (static_cast<float64>(e) + 0.5) / 250.0));
+        const float64 azimuth = static_cast<float64>(e) * 2.39996322972865332;
+        ASSERT_TRUE(matrix.add_lead("e" + std::to_string(e),
+                                    {std::sin(polar) * std::cos(azimuth), std::sin(polar) * std::sin(azimuth),
+                                     std::cos(polar)}));
+    }
+    ASSERT_EQ(matrix.lead_count(), 250U);
+
+    const std::size_t count = 1027U;
+    std::vector<float64> hx(count);
+    std::vector<float64> hy(count);
+    std::vector<float64> hz(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        hx[i] = std::sin(0.01 * static_cast<float64>(i));
+        hy[i] = std::cos(0.02 * static_cast<float64>(i));
+        hz[i] = 0.001 * static_cast<float64>(i);
+    }
+
+    const std::size_t stride = count + 5U;
+    std::vector<float64> out(stride * matrix.lead_count(), 0.0);
+    matrix.project(hx.data(), hy.data(), hz.data(), count, out.data(), stride);
+
+    for (std::size_t lead = 0; lead < matrix.lead_count(); ++lead)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const float64 expected = project_to_lead({hx[i], hy[i], hz[i]}, matrix.direction(lead));
+            ASSERT_EQ(out[(lead * stride) + i], expected) << "lead " << lead << " sample " << i;
+        }
+    }
+}
+
+TEST(LeadMatrix, LoadsFileAndDrivesEngineWidth)
+{
+    const std::string path = testing::TempDir() + "ecg_leads_test.txt";
+    {
+        std::ofstream file(path);
+        file << "# name x y z\n"
+             << "A 1 0 0\n"
+             << "\n"
+             << "B 0 2 0\n"
+             << "C 0 0 -1\n";
+    }
+
+    Lead_matrix matrix;
+    ASSERT_TRUE(matrix.load(path));
+    ASSERT_EQ(matrix.lead_count(), 3U);
+    EXPECT_EQ(matrix.name(1), "B");
+    EXPECT_DOUBLE_EQ(matrix.direction(1).y, 1.0);
+
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    ECGSimulationEngine engine(morphology, 60.0, 500.0);
+    engine.set_lead_matrix(matrix);
+    ASSERT_EQ(engine.lead_count(), 3U);
+
+    Sample_block block{};
+    allocate_sample_block(&block, 256U, engine.lead_count());
+    ASSERT_EQ(engine.render_block(&block, 256U), 256U);
+    const std::vector<Lead_sample> reference = generate_ecg_timeseries(morphology, 60.0, 500.0, 1.0);
+    for (std::size_t i = 0; i < block.count; ++i)
+    {
+        EXPECT_NEAR(lead_column(&block, 0U)[i], reference[i].leads[lead_i_index], 1e-12);
+        EXPECT_NEAR(lead_column(&block, 1U)[i], reference[i].leads[lead_avf_index], 1e-12);
+    }
+
+    {
+        std::ofstream file(path);
+        file << "A 1 0\n";
+    }
+    EXPECT_FALSE(matrix.load(path));
+    EXPECT_EQ(matrix.lead_count(), 3U);
+    std::remove(path.c_str());
+}
+
+TEST(ECGAdc, QuantizesWithGainOffsetAndSaturation)
+{
+    Adc_config config;
+    config.resolution_bits = 16;
+    config.lsb_mv = 0.0025;
+    config.lead_gain = {1.0, 2.0, 1.0};
+    config.lead_offset_mv = {0.0, 0.0, 0.01};
+
+    Adc_emulator adc;
+    ASSERT_TRUE(adc.configure(config, 3U));
+
+    // Odd count so both the vector body and the scalar tail are exercised.
+    const std::size_t count = 7U;
+    const std::size_t stride = 8U;
+    const std::vector<float64> leads = {
+        0.0, 0.0025, -0.0025, 0.00375, 100.0, -100.0, 0.00126, 0.0,
+        0.0, 0.0025, -0.0025, 0.00375, 100.0, -100.0, 0.00126, 0.0,
+        0.0, 0.0025, -0.0025, 0.00375, 100.0, -100.0, 0.00126, 0.0};
+
+    Adc_block block{};
+    allocate_adc_block(&block, stride, 3U, 16);
+    adc.convert(leads.data(), count, stride, 42U, &block);
+
+    ASSERT_EQ(block.count, count);
+    EXPECT_EQ(block.start_index, 42U);
+    const std::vector<int16> lead0(block.codes16.begin(), block.codes16.begin() + count);
+    const std::vector<int16> lead1(block.codes16.begin() + stride, block.codes16.begin() + stride + count);
+    const std::vector<int16> lead2(block.codes16.begin() + 2 * stride, block.codes16.begin() + 2 * stride + count);
+    // 0.00375 mV is 1.5 LSB and rounds to the even code 2.
+    EXPECT_EQ(lead0, (std::vector<int16>{0, 1, -1, 2, 32767, -32768, 1}));
+    EXPECT_EQ(lead1, (std::vector<int16>{0, 2, -2, 3, 32767, -32768, 1}));
+    EXPECT_EQ(lead2, (std::vector<int16>{4, 5, 3, 6, 32767, -32768, 5}));
+    EXPECT_EQ(block.clipped, 6U);
+
+    // NaN saturates to the lowest code and counts as clipped, whether it
+    // falls in the vector body (index 1) or the scalar tail (index 5).
+    std::vector<float64> with_nan = leads;
+    for (std::size_t lead = 0; lead < 3U; ++lead)
+    {
+        with_nan[(lead * stride) + 1U] = std::nan("");
+        with_nan[(lead * stride) + 5U] = std::nan("");
+    }
+    adc.convert(with_nan.data(), count, stride, 0U, &block);
+    for (std::size_t lead = 0; lead < 3U; ++lead)
+    {
+        EXPECT_EQ(block.codes16[(lead * stride) + 1U], -32768) << "lead " << lead;
+        EXPECT_EQ(block.codes16[(lead * stride) + 5U], -32768) << "lead " << lead;
+    }
+    EXPECT_EQ(block.clipped, 9U);
+
+    config.lead_gain = {1.0};
+    EXPECT_FALSE(adc.configure(config, 3U));
+}
+
+TEST(ECGAdc, EngineStageIsDeterministicAndCheckpointed)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    Adc_config config;
+    config.resolution_bits = 24;
+    config.dither = true;
+    config.dither_seed = 77U;
+
+    ECGSimulationEngine first(morphology, 72.0, 500.0);
+    ECGSimulationEngine second(morphology, 72.0, 500.0);
+    ASSERT_TRUE(first.set_adc(config));
+    ASSERT_TRUE(second.set_adc(config));
+
+    Sample_block a{};
+    Sample_block b{};
+    allocate_sample_block(&a, 300U, standard_lead_count);
+    allocate_sample_block(&b, 300U, standard_lead_count);
+    allocate_adc_block(&a.adc, 300U, standard_lead_count, 24);
+    allocate_adc_block(&b.adc, 300U, standard_lead_count, 24);
+
+    first.generate_block(&a, 300U);
+    second.generate_block(&b, 300U);
+    EXPECT_TRUE(a.adc.codes32 == b.adc.codes32);
+
+    // Dithered codes stay within one code of the undithered rounding.
+    for (std::size_t i = 0; i < a.count; ++i)
+    {
+        const float64 exact = lead_column(&a, lead_ii_index)[i] / config.lsb_mv;
+        EXPECT_LE(std::abs(static_cast<float64>(a.adc.codes32[(lead_ii_index * a.capacity) + i]) - exact), 1.5);
+    }
+
+    std::vector<uint8> state;
+    Checkpoint_writer writer(&state);
+    first.save_state(&writer);
+    ECGSimulationEngine restored(morphology, 72.0, 500.0);
+    config.dither_seed = 5U;
+    ASSERT_TRUE(restored.set_adc(config));
+    Checkpoint_reader reader(state.data(), state.size());
+    ASSERT_TRUE(restored.restore_state(&reader));
+
+    first.generate_block(&a, 300U);
+    restored.generate_block(&b, 300U);
+    EXPECT_TRUE(a.adc.codes32 == b.adc.codes32);
+}
+
+namespace
+{
+// Snapshot whose fields all derive from `k`, so a torn read is detectable.
+Live_parameters numbered_snapshot(uint64 k)
+{
+    Live_parameters parameters{};
+    parameters.morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    parameters.morphology.t_wave.shape_params.scale = 0.2 + (0.001 * static_cast<float64>(k % 100U));
+    parameters.heart_rate_bpm = 60.0 + static_cast<float64>(k % 30U);
+    parameters.noise_gain = static_cast<float64>(k);
+    return parameters;
+}
+
+bool is_consistent(const Live_parameters &parameters)
+{
+    const Live_parameters expected = numbered_snapshot(static_cast<uint64>(parameters.noise_gain));
+    return parameters.heart_rate_bpm == expected.heart_rate_bpm &&
+           parameters.morphology.t_wave.shape_params.scale == expected.morphology.t_wave.shape_params.scale;
+}
+
+float64 expected_lead_ii(const Ecg_morphology &morphology, float64 local_time_s)
+{
+    return project_to_lead(calculate_heart_vector(&morphology, local_time_s), Standard_leads::lead_ii);
+}
+} // namespace
+
+TEST(ECGLiveParameters, ChannelNeverDeliversTornSnapshots)
+{
+    Parameter_channel channel;
+    uint64 seen = 0U;
+    Live_parameters received{};
+    EXPECT_FALSE(channel.poll(&seen, &received));
+
+    channel.publish(numbered_snapshot(1U));
+    channel.publish(numbered_snapshot(2U));
+    ASSERT_TRUE(channel.poll(&seen, &received));
+    EXPECT_EQ(received.noise_gain, 2.0); // only the newest snapshot
+    EXPECT_FALSE(channel.poll(&seen, &received));
+
+    std::atomic<bool> stop{false};
+    std::thread publisher([&channel, &stop]() {
+        for (uint64 k = 3U; !stop.load(); ++k)
+        {
+            channel.publish(numbered_snapshot(k));
+            std::this_thread::yield();
+        }
+    });
+    int32 accepted = 0;
+    float64 last = 2.0;
+    for (int32 i = 0; i < 10000000 && accepted < 100; ++i)
+    {
+        if (channel.poll(&seen, &received))
+        {
+            ++accepted;
+            EXPECT_TRUE(is_consistent(received));
+            EXPECT_GT(received.noise_gain, last);
+            last = received.noise_gain;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    stop.store(true);
+    publisher.join();
+    EXPECT_GT(accepted, 0);
+}
+
+TEST(ECGLiveParameters, UpdatesTakeEffectAtTheNextBeat)
+{
+    // 60 bpm at 500 Hz: beats of exactly 500 samples.
+    const Ecg_morphology first = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    const Ecg_morphology second = create_normal_sinus_morphology(0.12, 0.08, -30.0);
+    ECGSimulationEngine engine(first, 60.0, 500.0);
+    Parameter_channel channel;
+    engine.set_parameter_channel(&channel);
+    ASSERT_TRUE(engine.is_live());
+
+    Sample_block block{};
+    allocate_sample_block(&block, 600U, standard_lead_count);
+    allocate_live_block(&block);
+
+    // Published before the first beat ends: applies from sample 500, where
+    // the beat at 120 bpm runs to sample 750.
+    channel.publish({second, 120.0, 1.0});
+    ASSERT_EQ(engine.generate_block(&block, 600U), 600U);
+    for (std::size_t i = 0; i < block.count; ++i)
+    {
+        const float64 t = block.time_s[i];
+        const float64 expected = (i < 500U) ? expected_lead_ii(first, t) : expected_lead_ii(second, t - 1.0);
+        ASSERT_NEAR(lead_column(&block, lead_ii_index)[i], expected, 1e-12) << "sample " << i;
+    }
+
+    // Published mid-beat: the current beat finishes unchanged.
+    channel.publish({first, 60.0, 1.0});
+    ASSERT_EQ(engine.generate_block(&block, 600U), 600U);
+    for (std::size_t i = 0; i < block.count; ++i)
+    {
+        const float64 t = block.time_s[i];
+        const float64 expected = (t < 1.5 - 1e-9) ? expected_lead_ii(second, t - 1.0) : expected_lead_ii(first, t - 1.5);
+        ASSERT_NEAR(lead_column(&block, lead_ii_index)[i], expected, 1e-12) << "sample " << (600U + i);
+    }
+    EXPECT_TRUE(block.has_live_state);
+    EXPECT_DOUBLE_EQ(block.live_state.heart_rate_bpm, 60.0);
+    EXPECT_DOUBLE_EQ(block.live_state.beat_start_s, 1.5);
+
+    // Invalid rates are ignored.
+    channel.publish({second, 0.0, 1.0});
+    engine.generate_block(&block, 600U);
+    EXPECT_DOUBLE_EQ(engine.heart_rate_bpm(), 60.0);
+}
+
+TEST(ECGLiveParameters, NoiseGainScalesOnlyTheNoise)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    ECGSimulationEngine clean(morphology, 60.0, 500.0);
+    ECGSimulationEngine noisy(morphology, 60.0, 500.0);
+    ECGSimulationEngine live(morphology, 60.0, 500.0);
+    noisy.add_noise_source(std::make_shared<WhiteNoiseGenerator>(0.05, 42U));
+    noisy.add_noise_source(std::make_shared<BaselineWanderGenerator>(0.1));
+    live.add_noise_source(std::make_shared<WhiteNoiseGenerator>(0.05, 42U));
+    live.add_noise_source(std::make_shared<BaselineWanderGenerator>(0.1));
+    Parameter_channel channel;
+    live.set_parameter_channel(&channel);
+    channel.publish({morphology, 60.0, 0.25});
+
+    Sample_block a{};
+    Sample_block b{};
+    Sample_block c{};
+    allocate_sample_block(&a, 800U, standard_lead_count);
+    allocate_sample_block(&b, 800U, standard_lead_count);
+    allocate_sample_block(&c, 800U, standard_lead_count);
+    allocate_live_block(&c);
+    clean.generate_block(&a, 800U);
+    noisy.generate_block(&b, 800U);
+    live.generate_block(&c, 800U);
+
+    for (std::size_t lead = 0; lead < standard_lead_count; ++lead)
+    {
+        for (std::size_t i = 0; i < c.count; ++i)
+        {
+            const float64 gain = (i < 500U) ? 1.0 : 0.25;
+            const float64 noise = lead_column(&b, lead)[i] - lead_column(&a, lead)[i];
+            ASSERT_NEAR(lead_column(&c, lead)[i], lead_column(&a, lead)[i] + (gain * noise), 1e-9);
+        }
+    }
+}
+
+TEST(ECGLiveParameters, PipelineCheckpointsCarryLiveParameters)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    const uint64 total = 6000U;
+
+    std::vector<float64> uninterrupted;
+    std::vector<std::vector<uint8>> checkpoints;
+    bool consistent = true;
+    {
+        ECGSimulationEngine engine(morphology, 72.0, 500.0);
+        engine.add_noise_source(std::make_shared<WhiteNoiseGenerator>(0.05, 7U));
+        Parameter_channel channel;
+        engine.set_parameter_channel(&channel);
+        channel.publish({create_normal_sinus_morphology(0.2, 0.09, 30.0), 95.0, 0.5});
+
+        Pipeline_config config;
+        config.block_samples = 256U;
+        config.block_count = 4U;
+        config.checkpoint_interval_blocks = 8U;
+        ECGPipeline pipeline(&engine, config);
+        pipeline.set_sink([&uninterrupted, &consistent](Sample_block *block) {
+            consistent = consistent && block->has_noise_gain && block->has_live_state;
+            uninterrupted.insert(uninterrupted.end(), lead_column(block, lead_i_index),
+                                 lead_column(block, lead_i_index) + block->count);
+            return true;
+        });
+        pipeline.set_checkpoint_handler([&](const std::vector<uint8> &state) {
+            checkpoints.push_back(state);
+            return true;
+        });
+        ASSERT_TRUE(pipeline.run(total));
+    }
+    EXPECT_TRUE(consistent);
+    ASSERT_GE(checkpoints.size(), 2U);
+
+    // The resumed engine has no channel but continues in live mode with the
+    // parameters in effect at the checkpoint.
+    ECGSimulationEngine resumed(morphology, 72.0, 500.0);
+    resumed.add_noise_source(std::make_shared<WhiteNoiseGenerator>(0.05, 8U));
+    Checkpoint_reader reader(checkpoints[1].data(), checkpoints[1].size());
+    ASSERT_TRUE(resumed.restore_state(&reader));
+    EXPECT_TRUE(resumed.is_live());
+    EXPECT_DOUBLE_EQ(resumed.heart_rate_bpm(), 95.0);
+    EXPECT_EQ(resumed.next_sample_index(), 16U * 256U);
+
+    std::vector<float64> tail;
+    ECGPipeline pipeline(&resumed, Pipeline_config());
+    pipeline.set_sink([&tail](Sample_block *block) {
+        tail.insert(tail.end(), lead_column(block, lead_i_index), lead_column(block, lead_i_index) + block->count);
+        return true;
+    });
+    ASSERT_TRUE(pipeline.run(total - resumed.next_sample_index()));
+    ASSERT_EQ(tail.size(), total - (16U * 256U));
+    EXPECT_TRUE(std::equal(tail.begin(), tail.end(), uninterrupted.begin() + (16 * 256)));
+}
+
+TEST(ECGEvaluate, MatchesBlockPathInAnyOrder)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    ECGSimulationEngine streamed(morphology, 75.0, 500.0);
+    ECGSimulationEngine random_access(morphology, 75.0, 500.0);
+    for (ECGSimulationEngine *engine : {&streamed, &random_access})
+    {
+        engine->add_noise_source(std::make_shared<BaselineWanderGenerator>(0.1));
+        engine->add_noise_source(std::make_shared<MainsHumGenerator>(0.02, 50.0));
+    }
+
+    const std::size_t count = 1500U;
+    Sample_block block{};
+    allocate_sample_block(&block, count, standard_lead_count);
+    ASSERT_EQ(streamed.generate_block(&block, count), count);
+
+    // The same grid, in a scrambled order.
+    std::vector<std::size_t> order(count);
+    std::vector<float64> times(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        order[i] = (i * 7919U) % count;
+        times[i] = block.time_s[order[i]];
+    }
+    std::vector<float64> leads(count * standard_lead_count);
+    ASSERT_TRUE(random_access.evaluate(times.data(), count, leads.data(), count));
+    EXPECT_EQ(random_access.next_sample_index(), 0U);
+
+    for (std::size_t lead = 0; lead < standard_lead_count; ++lead)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            ASSERT_NEAR(leads[(lead * count) + i], lead_column(&block, lead)[order[i]], 1e-12);
+        }
+    }
+
+    // Off-grid and negative times are fine; a short stride or a non-finite
+    // time is not, and leaves the output untouched.
+    const float64 jittered[3] = {0.0123, -0.4, 1234.5678};
+    EXPECT_TRUE(random_access.evaluate(jittered, 3U, leads.data(), 3U));
+    EXPECT_FALSE(random_access.evaluate(times.data(), count, leads.data(), count - 1U));
+    const std::vector<float64> before = leads;
+    for (const float64 bad : {std::nan(""), std::numeric_limits<float64>::infinity()})
+    {
+        const float64 with_bad[3] = {0.1, bad, 0.2};
+        EXPECT_FALSE(random_access.evaluate(with_bad, 3U, leads.data(), 3U));
+    }
+    EXPECT_TRUE(leads == before);
+}
+
+TEST(ECGEvaluate, NoiseIsAFunctionOfTime)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    ECGSimulationEngine clean(morphology, 72.0, 500.0);
+    ECGSimulationEngine noisy(morphology, 72.0, 500.0);
+    noisy.add_noise_source(std::make_shared<WhiteNoiseGenerator>(0.05, 11U));
+
+    const std::size_t count = 20000U;
+    std::vector<float64> times(count);
+    std::vector<float64> reversed(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        // Irregular spacing: 2 ms with up to +-0.5 ms of jitter.
+        times[i] = (0.002 * static_cast<float64>(i)) + (0.0005 * std::sin(static_cast<float64>(i) * 1.7));
+        reversed[count - 1U - i] = times[i];
+    }
+
+    std::vector<float64> base(count * standard_lead_count);
+    std::vector<float64> first(count * standard_lead_count);
+    std::vector<float64> second(count * standard_lead_count);
+    ASSERT_TRUE(clean.evaluate(times.data(), count, base.data(), count));
+    ASSERT_TRUE(noisy.evaluate(times.data(), count, first.data(), count));
+    ASSERT_TRUE(noisy.evaluate(reversed.data(), count, second.data(), count));
+
+    float64 sum = 0.0;
+    float64 sum_squares = 0.0;
+    for (std::size_t lead = 0; lead < standard_lead_count; ++lead)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const std::size_t k = (lead * count) + i;
+            ASSERT_EQ(first[k], second[(lead * count) + (count - 1U - i)]);
+            const float64 noise = first[k] - base[k];
+            sum += noise;
+            sum_squares += noise * noise;
+        }
+    }
+    // Uniform on [-0.05, 0.05): mean 0, RMS 0.05 / sqrt(3).
+    const float64 total = static_cast<float64>(count * standard_lead_count);
+    EXPECT_NEAR(sum / total, 0.0, 1e-3);
+    EXPECT_NEAR(std::sqrt(sum_squares / total), 0.05 / std::sqrt(3.0), 1e-3);
+
+    // Streaming noise has no random access.
+    noisy.add_noise_source(std::make_shared<SpectralNoiseGenerator>(create_colored_noise_config(1.0, 0.02), 500.0));
+    EXPECT_FALSE(noisy.evaluate(times.data(), count, first.data(), count));
+}
+
+TEST(ECGLiveParameters, ChannelAttachedAfterPipelineIsBuilt)
+{
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    ECGSimulationEngine engine(morphology, 60.0, 500.0);
+    Pipeline_config config;
+    config.block_samples = 256U;
+    config.block_count = 3U;
+    ECGPipeline pipeline(&engine, config);
+
+    Parameter_channel channel;
+    engine.set_parameter_channel(&channel);
+    channel.publish({morphology, 120.0, 1.0});
+
+    uint64 samples = 0U;
+    bool live = true;
+    pipeline.set_sink([&](Sample_block *block) {
+        samples += block->count;
+        live = live && block->has_noise_gain && block->has_live_state;
+        return true;
+    });
+    ASSERT_TRUE(pipeline.run(2000U));
+    EXPECT_EQ(samples, 2000U);
+    EXPECT_TRUE(live);
+    EXPECT_DOUBLE_EQ(engine.heart_rate_bpm(), 120.0);
+}
+
+TEST(ECGCore, CInterfaceMatchesEngineBlocks)
+{
+    Ecg_core_engine *core = nullptr;
+    // A small internal block so one request spans several render blocks.
+    ASSERT_EQ(ecg_core_create(72.0, 500.0, 64U, &core), ecg_core_ok);
+    ASSERT_NE(core, nullptr);
+    ASSERT_EQ(ecg_core_lead_count(core), standard_lead_count);
+    EXPECT_STREQ(ecg_core_lead_name(core, lead_ii_index), "lead_II");
+    EXPECT_EQ(ecg_core_lead_name(core, standard_lead_count), nullptr);
+
+    const Ecg_core_morphology morphology = {0.18, 0.12, 45.0};
+    ASSERT_EQ(ecg_core_set_morphology(core, &morphology), ecg_core_ok);
+    const Ecg_core_noise noise = {0.05, 1234U, 0.1, 0.02, 50.0};
+    ASSERT_EQ(ecg_core_set_noise(core, &noise), ecg_core_ok);
+
+    const std::size_t count = 300U;
+    std::vector<double> times(count);
+    std::vector<double> leads(count * standard_lead_count);
+    ASSERT_EQ(ecg_core_generate(core, count, times.data(), leads.data(), count), ecg_core_ok);
+
+    ECGSimulationEngine engine(create_normal_sinus_morphology(0.18, 0.12, 45.0), 72.0, 500.0);
+    engine.add_noise_source(std::make_shared<WhiteNoiseGenerator>(0.05, 1234U));
+    engine.add_noise_source(std::make_shared<BaselineWanderGenerator>(0.1));
+    engine.add_noise_source(std::make_shared<MainsHumGenerator>(0.02, 50.0));
+    Sample_block block{};
+    allocate_sample_block(&block, count, standard_lead_count);
+    ASSERT_EQ(engine.generate_block(&block, count), count);
+
+    for (std::size_t lead = 0; lead < standard_lead_count; ++lead)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            ASSERT_EQ(leads[(lead * count) + i], lead_column(&block, lead)[i]);
+        }
+    }
+    EXPECT_EQ(times.back(), block.time_s[count - 1U]);
+
+    Ecg_core_stats stats{};
+    ASSERT_EQ(ecg_core_get_stats(core, &stats), ecg_core_ok);
+    EXPECT_EQ(stats.calls, 1U);
+    EXPECT_EQ(stats.samples, count);
+    EXPECT_EQ(stats.next_sample_index, count);
+    EXPECT_EQ(stats.lead_count, standard_lead_count);
+
+    ecg_core_destroy(core);
+}
+
+TEST(ECGCore, CInterfaceRejectsInvalidArguments)
+{
+    Ecg_core_engine *core = nullptr;
+    EXPECT_EQ(ecg_core_create(0.0, 500.0, 64U, &core), ecg_core_invalid_argument);
+    EXPECT_EQ(core, nullptr);
+    EXPECT_EQ(ecg_core_create(72.0, 500.0, 64U, nullptr), ecg_core_invalid_argument);
+    ASSERT_EQ(ecg_core_create(72.0, 500.0, 64U, &core), ecg_core_ok);
+
+    double leads[8] = {};
+    EXPECT_EQ(ecg_core_generate(core, 8U, nullptr, leads, 4U), ecg_core_invalid_argument);
+    EXPECT_EQ(ecg_core_generate(core, 8U, nullptr, nullptr, 8U), ecg_core_invalid_argument);
+    EXPECT_EQ(ecg_core_set_kernel(core, static_cast<Ecg_core_kernel>(7)), ecg_core_invalid_argument);
+    EXPECT_EQ(ecg_core_set_noise(core, nullptr), ecg_core_invalid_argument);
+
+    // Mains hum without a frequency is refused and the sources are kept.
+    const Ecg_core_noise mains = {0.0, 0U, 0.0, 0.02, 50.0};
+    ASSERT_EQ(ecg_core_set_noise(core, &mains), ecg_core_ok);
+    std::vector<double> with_mains(8U * standard_lead_count);
+    ASSERT_EQ(ecg_core_generate(core, 8U, nullptr, with_mains.data(), 8U), ecg_core_ok);
+    const Ecg_core_noise no_frequency = {0.0, 0U, 0.0, 0.02, 0.0};
+    const Ecg_core_noise negative_frequency = {0.0, 0U, 0.0, 0.02, -50.0};
+    EXPECT_EQ(ecg_core_set_noise(core, &no_frequency), ecg_core_invalid_argument);
+    EXPECT_EQ(ecg_core_set_noise(core, &negative_frequency), ecg_core_invalid_argument);
+    ASSERT_EQ(ecg_core_seek(core, 0U), ecg_core_ok);
+    std::vector<double> kept(8U * standard_lead_count);
+    ASSERT_EQ(ecg_core_generate(core, 8U, nullptr, kept.data(), 8U), ecg_core_ok);
+    EXPECT_TRUE(kept == with_mains);
+    EXPECT_STREQ(ecg_core_status_string(ecg_core_invalid_argument), "invalid argument");
+    EXPECT_EQ(ecg_core_abi_version(), static_cast<uint32_t>(ECG_CORE_ABI_VERSION));
+
+    ecg_core_destroy(core);
+    ecg_core_destroy(nullptr);
+}
+
+TEST(ECGFft, MatchesDirectTransformAndInverts)
+{
+    const std::size_t n = 64U;
+    Fft_plan plan;
+    ASSERT_FALSE(plan.configure(48U));
+    ASSERT_TRUE(plan.configure(n));
+
+    std::vector<float64> re(n);
+    std::vector<float64> im(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        re[i] = std::sin(0.3 * static_cast<float64>(i)) + (0.01 * static_cast<float64>(i));
+        im[i] = std::cos(1.7 * static_cast<float64>(i));
+    }
+    const std::vector<float64> re0 = re;
+    const std::vector<float64> im0 = im;
+
+    plan.forward(re.data(), im.data());
+    for (std::size_t k = 0; k < n; ++k)
+    {
+        float64 sum_re = 0.0;
+        float64 sum_im = 0.0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            const float64 angle = -2.0 * pi_value * static_cast<float64>(i * k) / static_cast<float64>(n);
+            sum_re += (re0[i] * std::cos(angle)) - (im0[i] * std::sin(angle));
+            sum_im += (re0[i] * std::sin(angle)) + (im0[i] * std::cos(angle));
+        }
+        EXPECT_NEAR(re[k], sum_re, 1e-10);
+        EXPECT_NEAR(im[k], sum_im, 1e-10);
+    }
+
+    plan.inverse(re.data(), im.data());
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        EXPECT_NEAR(re[i], re0[i], 1e-12);
+        EXPECT_NEAR(im[i], im0[i], 1e-12);
+    }
+}
+
+namespace
+{
+// Slope of log(power) against log(frequency), from an averaged periodogram
+// between f_lo and f_hi.
+float64 spectral_slope(const std::vector<float64> &x, float64 fs, float64 f_lo, float64 f_hi)
+{
+    const std::size_t n = 1024U;
+    Fft_plan plan;
+    plan.configure(n);
+    std::vector<float64> power(n / 2U, 0.0);
+    std::vector<float64> re(n);
+    std::vector<float64> im(n);
+    for (std::size_t start = 0; start + n <= x.size(); start += n)
+    {
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            const float64 w = 0.5 - (0.5 * std::cos(2.0 * pi_value * static_cast<float64>(i) / static_cast<float64>(n)));
+            re[i] = x[start + i] * w;
+            im[i] = 0.0;
+        }
+        plan.forward(re.data(), im.data());
+        for (std::size_t k = 0; k < n / 2U; ++k)
+        {
+            power[k] += (re[k] * re[k]) + (im[k] * im[k]);
+        }
+    }
+
+    float64 sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0, m = 0.0;
+    for (std::size_t k = 1; k < n / 2U; ++k)
+    {
+        const float64 f = static_cast<float64>(k) * fs / static_cast<float64>(n);
+        if (f < f_lo || f > f_hi)
+        {
+            continue;
+        }
+        const float64 lx = std::log(f);
+        const float64 ly = std::log(power[k]);
+        sx += lx;
+        sy += ly;
+        sxx += lx * lx;
+        sxy += lx * ly;
+        m += 1.0;
+    }
+    return ((m * sxy) - (sx * sy)) / ((m * sxx) - (sx * sx));
+}
+
+float64 rms_of(const float64 *x, std::size_t n)
+{
+    float64 sum = 0.0;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        sum += x[i] * x[i];
+    }
+    return std::sqrt(sum / static_cast<float64>(n));
+}
+} // namespace
+
+TEST(ECGSpectralNoise, ShapesSpectrumAndRms)
+{
+    const float64 fs = 500.0;
+    const std::size_t n = 200000U;
+    for (const float64 alpha : {0.0, 1.0, 2.0})
+    {
+        Spectral_noise_config config = create_colored_noise_config(alpha, 0.05);
+        config.seed = 11U;
+        SpectralNoiseGenerator noise(config, fs);
+        std::vector<float64> x(n, 0.0);
+        std::vector<float64> times(n, 0.0);
+        noise.add_to_leads(times.data(), n, x.data(), 1U, n);
+
+        EXPECT_NEAR(rms_of(x.data(), n), 0.05, 0.05 * 0.15) << "alpha " << alpha;
+        EXPECT_NEAR(spectral_slope(x, fs, 2.0, 100.0), -alpha, 0.15) << "alpha " << alpha;
+    }
+}
+
+TEST(ECGSpectralNoise, KeepsSpectrumThroughPerSampleGenerate)
+{
+    // generate() must advance the source once per sample, not once per
+    // lead; otherwise each lead sees a decimated stream whose spectrum is
+    // stretched by the lead count. A band edge makes that visible.
+    const float64 fs = 500.0;
+    const float64 duration_s = 200.0;
+    const Ecg_morphology morphology = create_normal_sinus_morphology(0.16, 0.10, 60.0);
+    ECGSimulationEngine clean(morphology, 72.0, fs);
+    ECGSimulationEngine noisy(morphology, 72.0, fs);
+    Spectral_noise_config config = create_colored_noise_config(1.0, 0.05);
+    config.high_hz = 25.0;
+    config.seed = 5U;
+    noisy.add_noise_source(std::make_shared<SpectralNoiseGenerator>(config, fs));
+
+    const std::vector<Lead_sample> expected = clean.generate(duration_s);
+    const std::vector<Lead_sample> samples = noisy.generate(duration_s);
+    ASSERT_EQ(samples.size(), expected.size());
+
+    SpectralNoiseGenerator stream(config, fs);
+    std::vector<float64> reference(samples.size(), 0.0);
+    std::vector<float64> times(samples.size(), 0.0);
+    stream.add_to_leads(times.data(), reference.size(), reference.data(), 1U, reference.size());
+
+    for (const std::size_t lead : {lead_i_index, lead_v6_index})
+    {
+        std::vector<float64> x(samples.size());
+        for (std::size_t i = 0; i < samples.size(); ++i)
+        {
+            x[i] = samples[i].leads[lead] - expected[i].leads[lead];
+            ASSERT_NEAR(x[i], reference[i], 1e-12) << "lead " << lead << " sample " << i;
+        }
+        EXPECT_NEAR(spectral_slope(x, fs, 2.0, 15.0), -1.0, 0.2) << "lead " << lead;
+        EXPECT_LT(spectral_slope(x, fs, 50.0, 200.0), -4.0) << "lead " << lead;
+    }
+}
+
+TEST(ECGSpectralNoise, CompositeForwardsBlocksToComponents)
+{
+    // Inside a composite the spectral source must still advance once per
+    // sample for all leads, exactly as on its own.
+    Spectral_noise_config config = create_colored_noise_config(1.0, 0.05);
+    config.correlation = 0.5;
+    SpectralNoiseGenerator alone(config, 500.0, 3U);
+    SpectralNoiseGenerator inner(config, 500.0, 3U);
+    CompositeGenerator composite;
+    composite.add(&inner);
+
+    const std::size_t n = 3000U;
+    const std::size_t leads = standard_lead_count;
+    std::vector<float64> times(n, 0.0);
+    std::vector<float64> expected(n * leads, 0.0);
+    std::vector<float64> actual(n * leads, 0.0);
+    alone.add_to_leads(times.data(), n, expected.data(), leads, n);
+    composite.add_to_leads(times.data(), n, actual.data(), leads, n);
+    EXPECT_TRUE(actual == expected);
+}
+
+TEST(ECGSpectralNoise, BlockAndSampleEntryPointsAgree)
+{
+    Spectral_noise_config config = create_emg_noise_config(0.02);
+    config.fft_size = 256U;
+    SpectralNoiseGenerator per_sample(config, 500.0);
+    SpectralNoiseGenerator per_block(config, 500.0);
+
+    // Block sizes that straddle hop boundaries.
+    const std::size_t n = 1000U;
+    std::vector<float64> block(n, 0.0);
+    std::vector<float64> times(n, 0.0);
+    std::size_t done = 0U;
+    for (const std::size_t size : {37U, 128U, 300U, 535U})
+    {
+        per_block.add_to_leads(times.data(), size, block.data() + done, 1U, size);
+        done += size;
+    }
+    ASSERT_EQ(done, n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        ASSERT_EQ(per_sample.get_value(0.0), block[i]) << "sample " << i;
+    }
+}
+
+TEST(ECGSpectralNoise, ChannelCorrelationAndBursts)
+{
+    const std::size_t n = 60000U;
+    const std::size_t leads = 3U;
+    std::vector<float64> times(n, 0.0);
+    for (const float64 correlation : {0.0, 0.5, 1.0})
+    {
+        Spectral_noise_config config = create_colored_noise_config(0.0, 0.1);
+        config.correlation = correlation;
+        SpectralNoiseGenerator noise(config, 500.0, leads);
+        std::vector<float64> x(n * leads, 0.0);
+        noise.add_to_leads(times.data(), n, x.data(), leads, n);
+
+        float64 cross = 0.0;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            cross += x[i] * x[n + i];
+        }
+        const float64 rho = cross / (static_cast<float64>(n) * rms_of(x.data(), n) * rms_of(x.data() + n, n));
+        EXPECT_NEAR(rho, correlation, 0.05) << "correlation " << correlation;
+    }
+
+    // EMG bursts: quiet stretches between bursts are near the floor gain.
+    Spectral_noise_config emg = create_emg_noise_config(0.1);
+    emg.burst_floor = 0.0;
+    SpectralNoiseGenerator bursty(emg, 500.0);
+    std::vector<float64> x(n, 0.0);
+    bursty.add_to_leads(times.data(), n, x.data(), 1U, n);
+    std::size_t quiet = 0U;
+    std::size_t loud = 0U;
+    for (std::size_t start = 0; start + 50U <= n; start += 50U)
+    {
+        const float64 r = rms_of(x.data() + start, 50U);
+        quiet += (r < 0.01) ? 1U : 0U;
+        loud += (r > 0.05) ? 1U : 0U;
+    }
+    EXPECT_GT(quiet, 100U);
+    EXPECT_GT(loud, 50U);
+}
+
+TEST(ECGSpectralNoise, CheckpointResumesStream)
+{
+    Spectral_noise_config config = create_motion_artifact_config(0.2);
+    config.fft_size = 512U;
+    config.correlation = 0.3;
+    const std::size_t leads = 2U;
+    SpectralNoiseGenerator original(config, 250.0, leads);
+    std::vector<float64> times(400U, 0.0);
+    std::vector<float64> a(800U, 0.0);
+    original.add_to_leads(times.data(), 333U, a.data(), leads, 400U);
+
+    std::vector<uint8> state;
+    Checkpoint_writer writer(&state);
+    original.save_state(&writer);
+
+    SpectralNoiseGenerator restored(config, 250.0, leads);
+    Checkpoint_reader reader(state.data(), state.size());
+    ASSERT_TRUE(restored.restore_state(&reader));
+    EXPECT_EQ(reader.remaining(), 0U);
+
+    std::vector<float64> b(800U, 0.0);
+    std::fill(a.begin(), a.end(), 0.0);
+    original.add_to_leads(times.data(), 400U, a.data(), leads, 400U);
+    restored.add_to_leads(times.data(), 400U, b.data(), leads, 400U);
+    EXPECT_TRUE(a == b);
+
+    SpectralNoiseGenerator mismatched(config, 250.0, 3U);
+    Checkpoint_reader again(state.data(), state.size());
+    EXPECT_FALSE(mismatched.restore_state(&again));
+}
@@ -13,18 +13,8 @@ const float64 t_wave_axis_offset_degrees = 20.0;
 const float64 t_wave_amplitude_scale = 0.35;
 
 // QRS Complex
+// Q, R and S waves: qrs_wave_centers etc. in ECGMorphology.h.
 const float64 qrs_amplitude_scale = 1.2;
-const float64 q_wave_scale_factor = -0.25;
-const float64 r_wave_scale_factor = 1.0;
-const float64 s_wave_scale_factor = -0.35;
-
-const float64 q_wave_center = 0.20;
-const float64 r_wave_center = 0.45;
-const float64 s_wave_center = 0.70;
-
-const float64 q_wave_width = 0.06;
-const float64 r_wave_width = 0.04;
-const float64 s_wave_width = 0.08;
 
 // Intervals
 const float64 st_segment_gap_s = 0.04;
@@ -96,15 +86,12 @@ static Heart_vector calculate_qrs_vector(const Ecg_component *component,
   }
 
   Heart_vector result = {0.0, 0.0, 0.0};
-  result = add(result,
-               calculate_gaussian_vector(component, local_time, q_wave_center,
-                                         q_wave_width, q_wave_scale_factor));
-  result = add(result,
-               calculate_gaussian_vector(component, local_time, r_wave_center,
-                                         r_wave_width, r_wave_scale_factor));
-  result = add(result,
-               calculate_gaussian_vector(component, local_time, s_wave_center,
-                                         s_wave_width, s_wave_scale_factor));
+  for (std::size_t wave = 0; wave < qrs_wave_count; ++wave) {
+    result = add(result, calculate_gaussian_vector(
+                             component, local_time, qrs_wave_centers[wave],
+                             qrs_wave_widths[wave],
+                             qrs_wave_scale_factors[wave]));
+  }
 
   return result;
 }
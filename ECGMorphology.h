@@ -4,6 +4,8 @@
 #include "ECGMath.h"
 #include "Types.h"
 
+#include <cstddef>
+
 // Rule 50, 45: Struct naming convention
 struct Gaussian_shape_params {
   Heart_vector direction;
@@ -25,6 +27,14 @@ struct Ecg_component {
 Heart_vector calculate_component_vector(const Ecg_component *component,
                                         float64 time);
 
+// The QRS complex is three Gaussians (Q, R and S) sharing the component's
+// direction. Centers and widths are fractions of the QRS duration; every
+// evaluator of the morphology uses these.
+const std::size_t qrs_wave_count = 3U;
+const float64 qrs_wave_centers[qrs_wave_count] = {0.20, 0.45, 0.70};
+const float64 qrs_wave_widths[qrs_wave_count] = {0.06, 0.04, 0.08};
+const float64 qrs_wave_scale_factors[qrs_wave_count] = {-0.25, 1.0, -0.35};
+
 struct Ecg_morphology {
   Ecg_component p_wave;
   Ecg_component qrs_complex;
@@ -34,6 +44,27 @@ struct Ecg_morphology {
 Heart_vector calculate_heart_vector(const Ecg_morphology *morphology,
                                     float64 local_time);
 
+// Accelerated evaluators of calculate_heart_vector() over a block of local
+// (within-beat) times. Each kernel trades accuracy for speed within the
+// budget enforced by ECGConformanceTests.cpp; the reference kernel calls
+// calculate_heart_vector() itself. The others evaluate tiles of samples with
+// vectorizable loops and a polynomial exp().
+enum Morphology_kernel {
+  morphology_kernel_reference = 0,
+  morphology_kernel_fast_exp, // float64 arithmetic
+  morphology_kernel_float32   // float32 arithmetic
+};
+
+// `local_times` may alias `x` (the kernel reads each time before writing).
+void calculate_heart_vectors(const Ecg_morphology *morphology,
+                             Morphology_kernel kernel,
+                             const float64 *local_times, std::size_t count,
+                             float64 *x, float64 *y, float64 *z);
+
+// exp() for non-positive arguments with a relative error below 1e-9; returns
+// exactly 0 below the point where the Gaussians are negligible.
+float64 fast_exp(float64 x);
+
 // Factory functions
 Ecg_morphology create_normal_sinus_morphology(float64 pr_interval,
                                               float64 qrs_duration,
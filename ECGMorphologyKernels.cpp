@@ -0,0 +1,293 @@
+#include "ECGMorphology.h"
+
+#include <cmath>
+#include <cstring>
+
+// These kernels mirror the arithmetic of calculate_component_vector() and the
+// QRS helpers in ECGMorphology.cpp, but evaluate a tile of samples at a time
+// so the compiler can vectorize them:
+//
+//   - a component whose window contains no sample of the tile is skipped, so
+//     most tiles cost a few comparisons per component;
+//   - otherwise the Gaussian arguments, the exp() and the window mask are
+//     computed in separate branch-free loops over the tile, with a polynomial
+//     exp() in the kernel's precision instead of a libm call.
+//
+// Any change to the reference morphology must be repeated here;
+// ECGConformanceTests.cpp will fail otherwise.
+
+namespace {
+// Rule 151: Avoid magic numbers.
+const float64 zero_tolerance = 1e-9;
+const std::size_t kernel_tile_samples = 64U;
+
+// Below this argument exp() is under 5e-18 and contributes nothing at the
+// millivolt scale of the waveform.
+const float64 fast_exp_cutoff = -40.0;
+
+// Adding 1.5 * 2^(mantissa bits) rounds to an integer and leaves it in the
+// low mantissa bits, without a rounding instruction.
+template <typename Real> struct Exp_constants;
+
+template <> struct Exp_constants<float64> {
+  typedef uint64 Bits;
+  static constexpr float64 log2_e = 1.44269504088896340736;
+  static constexpr float64 ln_2_hi = 6.93147180369123816490e-01;
+  static constexpr float64 ln_2_lo = 1.90821492927058770002e-10;
+  static constexpr float64 round_shift = 6755399441055744.0; // 1.5 * 2^52
+  static constexpr Bits exponent_bias = 1023U;
+  static constexpr int32 mantissa_bits = 52;
+};
+
+template <> struct Exp_constants<float32> {
+  typedef uint32 Bits;
+  static constexpr float32 log2_e = 1.44269504F;
+  static constexpr float32 ln_2_hi = 0.693145752F;
+  static constexpr float32 ln_2_lo = 1.42860677e-06F;
+  static constexpr float32 round_shift = 12582912.0F; // 1.5 * 2^23
+  static constexpr Bits exponent_bias = 127U;
+  static constexpr int32 mantissa_bits = 23;
+};
+
+// exp(x) = 2^k * exp(r), |r| <= ln(2)/2, with ln(2) split in two parts so
+// the reduction stays exact; exp(r) by a Taylor polynomial (degree 8 in
+// float64, truncation error < 2.5e-10; degree 6 in float32, < 4e-7).
+// x must not be below fast_exp_cutoff: callers clamp it in a separate loop,
+// otherwise the compiler branches around the polynomial and cannot
+// vectorize it.
+inline float64 exp_polynomial(float64 x) {
+  typedef Exp_constants<float64> C;
+  const float64 shifted = (x * C::log2_e) + C::round_shift;
+  const float64 k = shifted - C::round_shift;
+  const float64 r = (x - (k * C::ln_2_hi)) - (k * C::ln_2_lo);
+
+  float64 p = 1.0 / 40320.0;
+  p = (p * r) + (1.0 / 5040.0);
+  p = (p * r) + (1.0 / 720.0);
+  p = (p * r) + (1.0 / 120.0);
+  p = (p * r) + (1.0 / 24.0);
+  p = (p * r) + (1.0 / 6.0);
+  p = (p * r) + 0.5;
+  p = (p * r) + 1.0;
+  p = (p * r) + 1.0;
+
+  // The low bits of `shifted` hold k; moving k + bias into the exponent
+  // field builds 2^k (the bits above it shift out).
+  C::Bits bits;
+  std::memcpy(&bits, &shifted, sizeof(bits));
+  bits = (bits + C::exponent_bias) << C::mantissa_bits;
+  float64 two_to_k;
+  std::memcpy(&two_to_k, &bits, sizeof(two_to_k));
+  return p * two_to_k;
+}
+
+inline float32 exp_polynomial(float32 x) {
+  typedef Exp_constants<float32> C;
+  const float32 shifted = (x * C::log2_e) + C::round_shift;
+  const float32 k = shifted - C::round_shift;
+  const float32 r = (x - (k * C::ln_2_hi)) - (k * C::ln_2_lo);
+
+  float32 p = 1.0F / 720.0F;
+  p = (p * r) + (1.0F / 120.0F);
+  p = (p * r) + (1.0F / 24.0F);
+  p = (p * r) + (1.0F / 6.0F);
+  p = (p * r) + 0.5F;
+  p = (p * r) + 1.0F;
+  p = (p * r) + 1.0F;
+
+  C::Bits bits;
+  std::memcpy(&bits, &shifted, sizeof(bits));
+  bits = (bits + C::exponent_bias) << C::mantissa_bits;
+  float32 two_to_k;
+  std::memcpy(&two_to_k, &bits, sizeof(two_to_k));
+  return p * two_to_k;
+}
+
+// Gaussian argument -(diff^2), clamped to fast_exp_cutoff.
+template <typename Real> Real gaussian_argument(Real diff) {
+  const Real cutoff = static_cast<Real>(fast_exp_cutoff);
+  const Real arg = -(diff * diff);
+  return (arg < cutoff) ? cutoff : arg;
+}
+
+// Per-component parameters converted once per block to the kernel's type.
+template <typename Real> struct Kernel_component {
+  bool is_active;
+  Real start;
+  Real duration;
+  Real inv_duration;
+  Real dir_x;
+  Real dir_y;
+  Real dir_z;
+  Real scale;
+  Real center;
+  // Reciprocal widths before and after the center, with the asymmetry
+  // stretch applied to the side it affects.
+  Real inv_width_left;
+  Real inv_width_right;
+};
+
+template <typename Real>
+Kernel_component<Real> make_kernel_component(const Ecg_component &c) {
+  const Gaussian_shape_params &shape = c.shape_params;
+  Kernel_component<Real> k;
+  k.is_active = c.is_active && (c.duration_s > zero_tolerance);
+  k.start = static_cast<Real>(c.start_time_s);
+  k.duration = static_cast<Real>(c.duration_s);
+  k.inv_duration =
+      k.is_active ? static_cast<Real>(1.0 / c.duration_s) : static_cast<Real>(0);
+  k.dir_x = static_cast<Real>(shape.direction.x);
+  k.dir_y = static_cast<Real>(shape.direction.y);
+  k.dir_z = static_cast<Real>(shape.direction.z);
+  k.scale = static_cast<Real>(shape.scale);
+  k.center = static_cast<Real>(shape.center);
+  const float64 left = (shape.asymmetry < 0.0)
+                           ? shape.width * (1.0 - shape.asymmetry)
+                           : shape.width;
+  const float64 right = (shape.asymmetry > 0.0)
+                            ? shape.width * (1.0 + shape.asymmetry)
+                            : shape.width;
+  k.inv_width_left = static_cast<Real>(1.0 / left);
+  k.inv_width_right = static_cast<Real>(1.0 / right);
+  return k;
+}
+
+// Position within the component's window (u in [0, 1]) of every sample of
+// the tile, or -1 outside it. Returns false if no sample is inside.
+template <typename Real>
+bool window_positions(const Kernel_component<Real> &k, const Real *time,
+                      std::size_t n, Real *u) {
+  if (!k.is_active) {
+    return false;
+  }
+  int32 inside = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    const Real local_time = time[i] - k.start;
+    // Non-short-circuit & keeps the loop free of branches.
+    const bool in_window =
+        (local_time >= static_cast<Real>(0)) & (local_time <= k.duration);
+    u[i] = in_window ? local_time * k.inv_duration : static_cast<Real>(-1);
+    inside += in_window ? 1 : 0;
+  }
+  return inside > 0;
+}
+
+// Gaussian magnitude of a wave component for each sample of the tile.
+template <typename Real>
+void component_magnitudes(const Kernel_component<Real> &k, const Real *time,
+                          std::size_t n, Real *u, Real *magnitude) {
+  if (!window_positions(k, time, n, u)) {
+    for (std::size_t i = 0; i < n; ++i) {
+      magnitude[i] = static_cast<Real>(0);
+    }
+    return;
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    const Real inv_width =
+        (u[i] > k.center) ? k.inv_width_right : k.inv_width_left;
+    magnitude[i] = gaussian_argument((u[i] - k.center) * inv_width);
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    const Real value = k.scale * exp_polynomial(magnitude[i]);
+    magnitude[i] = (u[i] >= static_cast<Real>(0)) ? value : static_cast<Real>(0);
+  }
+}
+
+// Summed Q, R and S magnitudes along the QRS direction.
+template <typename Real>
+void qrs_magnitudes(const Kernel_component<Real> &k, const Real *time,
+                    std::size_t n, Real *u, Real *argument, Real *magnitude) {
+  if (!window_positions(k, time, n, u)) {
+    for (std::size_t i = 0; i < n; ++i) {
+      magnitude[i] = static_cast<Real>(0);
+    }
+    return;
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    magnitude[i] = static_cast<Real>(0);
+  }
+  for (std::size_t wave = 0; wave < qrs_wave_count; ++wave) {
+    const Real center = static_cast<Real>(qrs_wave_centers[wave]);
+    const Real inv_width = static_cast<Real>(1.0 / qrs_wave_widths[wave]);
+    const Real factor = static_cast<Real>(qrs_wave_scale_factors[wave]);
+    for (std::size_t i = 0; i < n; ++i) {
+      argument[i] = gaussian_argument((u[i] - center) * inv_width);
+    }
+    for (std::size_t i = 0; i < n; ++i) {
+      magnitude[i] += factor * exp_polynomial(argument[i]);
+    }
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    magnitude[i] = (u[i] >= static_cast<Real>(0)) ? k.scale * magnitude[i]
+                                                  : static_cast<Real>(0);
+  }
+}
+
+template <typename Real>
+void evaluate_block(const Ecg_morphology *morphology,
+                    const float64 *local_times, std::size_t count, float64 *x,
+                    float64 *y, float64 *z) {
+  const Kernel_component<Real> p =
+      make_kernel_component<Real>(morphology->p_wave);
+  const Kernel_component<Real> qrs =
+      make_kernel_component<Real>(morphology->qrs_complex);
+  const Kernel_component<Real> t =
+      make_kernel_component<Real>(morphology->t_wave);
+
+  Real time[kernel_tile_samples];
+  Real u[kernel_tile_samples];
+  Real argument[kernel_tile_samples];
+  Real p_mag[kernel_tile_samples];
+  Real qrs_mag[kernel_tile_samples];
+  Real t_mag[kernel_tile_samples];
+
+  for (std::size_t begin = 0; begin < count; begin += kernel_tile_samples) {
+    const std::size_t n = (count - begin < kernel_tile_samples)
+                              ? count - begin
+                              : kernel_tile_samples;
+    for (std::size_t i = 0; i < n; ++i) {
+      time[i] = static_cast<Real>(local_times[begin + i]);
+    }
+    component_magnitudes(p, time, n, u, p_mag);
+    qrs_magnitudes(qrs, time, n, u, argument, qrs_mag);
+    component_magnitudes(t, time, n, u, t_mag);
+
+    // local_times may alias x: the tile's times were copied above.
+    for (std::size_t i = 0; i < n; ++i) {
+      x[begin + i] = static_cast<float64>(
+          (p.dir_x * p_mag[i]) + (qrs.dir_x * qrs_mag[i]) + (t.dir_x * t_mag[i]));
+      y[begin + i] = static_cast<float64>(
+          (p.dir_y * p_mag[i]) + (qrs.dir_y * qrs_mag[i]) + (t.dir_y * t_mag[i]));
+      z[begin + i] = static_cast<float64>(
+          (p.dir_z * p_mag[i]) + (qrs.dir_z * qrs_mag[i]) + (t.dir_z * t_mag[i]));
+    }
+  }
+}
+} // namespace
+
+float64 fast_exp(float64 x) {
+  return (x < fast_exp_cutoff) ? 0.0 : exp_polynomial(x);
+}
+
+void calculate_heart_vectors(const Ecg_morphology *morphology,
+                             Morphology_kernel kernel,
+                             const float64 *local_times, std::size_t count,
+                             float64 *x, float64 *y, float64 *z) {
+  switch (kernel) {
+  case morphology_kernel_fast_exp:
+    evaluate_block<float64>(morphology, local_times, count, x, y, z);
+    break;
+  case morphology_kernel_float32:
+    evaluate_block<float32>(morphology, local_times, count, x, y, z);
+    break;
+  case morphology_kernel_reference:
+  default:
+    for (std::size_t i = 0; i < count; ++i) {
+      const Heart_vector v = calculate_heart_vector(morphology, local_times[i]);
+      x[i] = v.x;
+      y[i] = v.y;
+      z[i] = v.z;
+    }
+    break;
+  }
+}
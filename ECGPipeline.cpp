@@ -0,0 +1,224 @@
+#include "ECGPipeline.h"
+
+#include <chrono>
+#include <thread>
+
+namespace {
+// Rule 151: Avoid magic numbers. Busy-poll this many times before yielding
+// the core to another stage.
+constexpr int32 spin_iterations = 64;
+
+float64 seconds_between(std::chrono::steady_clock::time_point start,
+                        std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration<float64>(end - start).count();
+}
+} // namespace
+
+ECGPipeline::ECGPipeline(ECGSimulationEngine *engine,
+                         const Pipeline_config &config)
+    : engine_(engine), config_(config) {
+  if (config_.block_samples == 0U) {
+    config_.block_samples = 1U;
+  }
+  if (config_.block_count == 0U) {
+    config_.block_count = 1U;
+  }
+
+  // Block memory is allocated here; run() only reallocates blocks that no
+  // longer fit the engine, before any stage starts.
+  blocks_.resize(config_.block_count);
+  prepare_blocks();
+}
+
+void ECGPipeline::prepare_blocks() {
+  engine_->reserve_blocks(config_.block_samples);
+  const std::size_t lead_count = engine_->lead_count();
+  for (auto &block : blocks_) {
+    if (block.capacity != config_.block_samples ||
+        block.lead_count != lead_count) {
+      allocate_sample_block(&block, config_.block_samples, lead_count);
+    }
+    if (engine_->has_adc() &&
+        (block.adc.capacity != config_.block_samples ||
+         block.adc.lead_count != lead_count ||
+         block.adc.resolution_bits !=
+             engine_->adc_config().resolution_bits)) {
+      allocate_adc_block(&block.adc, config_.block_samples, lead_count,
+                         engine_->adc_config().resolution_bits);
+    }
+    if (engine_->is_live() &&
+        (block.noise_gain.size() != block.capacity ||
+         block.noise.size() != block.capacity * block.lead_count)) {
+      allocate_live_block(&block);
+    }
+  }
+}
+
+void ECGPipeline::set_post_processor(Block_stage stage) {
+  post_processor_ = std::move(stage);
+}
+
+void ECGPipeline::set_sink(Block_stage stage) { sink_ = std::move(stage); }
+
+void ECGPipeline::set_checkpoint_handler(Checkpoint_handler handler) {
+  checkpoint_handler_ = std::move(handler);
+}
+
+bool ECGPipeline::run(uint64 total_samples) {
+  stages_.clear();
+  stats_.clear();
+  // The engine may have been reconfigured since construction.
+  prepare_blocks();
+
+  // The engine renders nothing when it rejects the block or its own
+  // configuration; with samples still due that is a failure, not the end of
+  // the stream.
+  stages_.push_back({[this](Sample_block *block) {
+                       const uint64 cap = block->capacity;
+                       const uint64 n = (remaining_samples_ < cap)
+                                            ? remaining_samples_
+                                            : cap;
+                       engine_->render_block(block,
+                                             static_cast<std::size_t>(n));
+                       remaining_samples_ -= block->count;
+                       return block->count > 0U || n == 0U;
+                     },
+                     true});
+  stats_.push_back({"render"});
+
+  // The noise stage also runs the engine's ADC emulation, if any. The
+  // checkpoint is taken here: at that point the block's noise and dither
+  // have been drawn and no later block has touched those generators, so the
+  // saved state resumes exactly after this block.
+  const bool checkpoints =
+      checkpoint_handler_ && (config_.checkpoint_interval_blocks > 0U);
+  uint64 noise_blocks = 0U;
+  stages_.push_back(
+      {[this, checkpoints, noise_blocks](Sample_block *block) mutable {
+         engine_->apply_noise(block);
+         engine_->quantize(block);
+         block->has_checkpoint =
+             checkpoints &&
+             ((++noise_blocks % config_.checkpoint_interval_blocks) == 0U);
+         if (block->has_checkpoint) {
+           Checkpoint_writer writer(&block->checkpoint);
+           engine_->save_state(&writer, *block);
+         }
+         return true;
+       },
+       false});
+  stats_.push_back({"noise"});
+
+  if (post_processor_) {
+    stages_.push_back({post_processor_, false});
+    stats_.push_back({"post"});
+  }
+
+  stages_.push_back({[this](Sample_block *block) {
+                       if (sink_ && !sink_(block)) {
+                         return false;
+                       }
+                       if (block->has_checkpoint) {
+                         block->has_checkpoint = false;
+                         return checkpoint_handler_(block->checkpoint);
+                       }
+                       return true;
+                     },
+                     false});
+  stats_.push_back({"sink"});
+
+  queues_.clear();
+  for (std::size_t k = 0; k < stages_.size(); ++k) {
+    queues_.push_back(std::unique_ptr<Spsc_queue<Sample_block *>>(
+        new Spsc_queue<Sample_block *>(blocks_.size())));
+  }
+  for (auto &block : blocks_) {
+    queues_[0]->try_push(&block);
+  }
+
+  remaining_samples_ = total_samples;
+  aborted_.store(false);
+
+  const auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads;
+  threads.reserve(stages_.size());
+  for (std::size_t k = 0; k < stages_.size(); ++k) {
+    threads.emplace_back([this, k]() { run_stage(k); });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  const float64 wall_s =
+      seconds_between(start, std::chrono::steady_clock::now());
+  for (auto &stat : stats_) {
+    stat.wall_s = wall_s;
+  }
+
+  return !aborted_.load();
+}
+
+void ECGPipeline::run_stage(std::size_t stage_index) {
+  const Stage &stage = stages_[stage_index];
+  Stage_stats &stat = stats_[stage_index];
+  const std::size_t out_index = (stage_index + 1U) % stages_.size();
+
+  for (;;) {
+    Sample_block *block = nullptr;
+    if (!wait_pop(stage_index, &block)) {
+      return;
+    }
+
+    // A block with no samples marks the end of the stream; the source
+    // produces it once the requested samples are exhausted.
+    bool end_of_stream = !stage.is_source && (block->count == 0U);
+    if (!end_of_stream) {
+      const auto start = std::chrono::steady_clock::now();
+      const bool ok = stage.work(block);
+      stat.busy_s += seconds_between(start, std::chrono::steady_clock::now());
+      if (!ok) {
+        aborted_.store(true);
+        return;
+      }
+      if (block->count == 0U) {
+        end_of_stream = true;
+      } else {
+        ++stat.blocks;
+        stat.samples += block->count;
+      }
+    }
+
+    if (!wait_push(out_index, block) || end_of_stream) {
+      return;
+    }
+  }
+}
+
+bool ECGPipeline::wait_pop(std::size_t queue_index, Sample_block **block) {
+  int32 spins = 0;
+  while (!queues_[queue_index]->try_pop(block)) {
+    if (aborted_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    if (++spins >= spin_iterations) {
+      spins = 0;
+      std::this_thread::yield();
+    }
+  }
+  return true;
+}
+
+bool ECGPipeline::wait_push(std::size_t queue_index, Sample_block *block) {
+  int32 spins = 0;
+  while (!queues_[queue_index]->try_push(block)) {
+    if (aborted_.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    if (++spins >= spin_iterations) {
+      spins = 0;
+      std::this_thread::yield();
+    }
+  }
+  return true;
+}
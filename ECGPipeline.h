@@ -0,0 +1,150 @@
+#ifndef ECG_PIPELINE_H
+#define ECG_PIPELINE_H
+
+#include "ECGSimulation.h"
+#include "Types.h"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Bounded single-producer/single-consumer ring buffer.
+ *
+ * Exactly one thread may push and exactly one thread may pop. Neither side
+ * takes a lock; the producer publishes with a release store of the tail and
+ * the consumer with a release store of the head.
+ */
+template <typename T> class Spsc_queue {
+public:
+  explicit Spsc_queue(std::size_t capacity)
+      : slots_(round_up_to_power_of_two(capacity + 1U)),
+        mask_(slots_.size() - 1U) {}
+
+  bool try_push(const T &value) {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    const std::size_t next = (tail + 1U) & mask_;
+    if (next == head_.load(std::memory_order_acquire)) {
+      return false; // full
+    }
+    slots_[tail] = value;
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T *value) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false; // empty
+    }
+    *value = slots_[head];
+    head_.store((head + 1U) & mask_, std::memory_order_release);
+    return true;
+  }
+
+private:
+  static std::size_t round_up_to_power_of_two(std::size_t n) {
+    std::size_t result = 1U;
+    while (result < n) {
+      result <<= 1U;
+    }
+    return result;
+  }
+
+  // Rule 151: Avoid magic numbers. Typical cache line size, used to keep the
+  // two indices from sharing a line.
+  static const std::size_t cache_line_bytes = 64U;
+
+  std::vector<T> slots_;
+  std::size_t mask_;
+  alignas(cache_line_bytes) std::atomic<std::size_t> head_{0U};
+  alignas(cache_line_bytes) std::atomic<std::size_t> tail_{0U};
+};
+
+struct Pipeline_config {
+  std::size_t block_samples{4096U}; // samples per recycled block
+  std::size_t block_count{8U};      // blocks in flight (bounds memory)
+  std::size_t checkpoint_interval_blocks{0U}; // 0 disables checkpoints
+};
+
+struct Stage_stats {
+  std::string name;
+  uint64 blocks{0U};
+  uint64 samples{0U};
+  float64 busy_s{0.0}; // time spent inside the stage's work function
+  float64 wall_s{0.0}; // duration of the whole run
+
+  float64 utilization() const {
+    return (wall_s > 0.0) ? (busy_s / wall_s) : 0.0;
+  }
+};
+
+/**
+ * @brief Runs an ECGSimulationEngine as a chain of threaded stages.
+ *
+ * Stages are: render (morphology + lead projection), noise injection (and
+ * ADC emulation when the engine has it), an optional post-processor, and a
+ * sink (encoding/writing). Each stage runs on
+ * its own thread and hands blocks to the next through an Spsc_queue. The sink
+ * returns blocks to the render stage, so a fixed pool of blocks circulates
+ * and a slow stage stalls its producers instead of growing memory.
+ */
+class ECGPipeline {
+public:
+  // A stage returns false to abort the run (e.g. a failed write).
+  using Block_stage = std::function<bool(Sample_block *)>;
+
+  // Receives a serialized engine state (see ECGSimulationEngine::save_state)
+  // after every sample before the resume point has passed through the sink.
+  // Returning false aborts the run.
+  using Checkpoint_handler = std::function<bool(const std::vector<uint8> &)>;
+
+  // Blocks are sized for the engine's lead matrix, ADC and live mode at
+  // construction, and resized by run() if the engine has changed since.
+  ECGPipeline(ECGSimulationEngine *engine, const Pipeline_config &config);
+
+  void set_post_processor(Block_stage stage);
+  void set_sink(Block_stage stage);
+
+  // Called from the sink thread every `checkpoint_interval_blocks` blocks.
+  void set_checkpoint_handler(Checkpoint_handler handler);
+
+  // Stream `total_samples` samples from the engine's current cursor through
+  // all stages. Returns false if any stage aborted the run, including the
+  // render stage when the engine renders nothing before the total is
+  // reached.
+  bool run(uint64 total_samples);
+
+  // Per-stage statistics of the last run, in stage order.
+  const std::vector<Stage_stats> &stats() const { return stats_; }
+
+private:
+  struct Stage {
+    Block_stage work;
+    bool is_source;
+  };
+
+  void prepare_blocks();
+  void run_stage(std::size_t stage_index);
+  bool wait_pop(std::size_t queue_index, Sample_block **block);
+  bool wait_push(std::size_t queue_index, Sample_block *block);
+
+  ECGSimulationEngine *engine_;
+  Pipeline_config config_;
+  Block_stage post_processor_;
+  Block_stage sink_;
+  Checkpoint_handler checkpoint_handler_;
+
+  std::vector<Sample_block> blocks_;
+  std::vector<Stage> stages_;
+  // queues_[k] feeds stage k; queues_[0] holds free blocks for the source.
+  std::vector<std::unique_ptr<Spsc_queue<Sample_block *>>> queues_;
+  std::vector<Stage_stats> stats_;
+  std::atomic<bool> aborted_{false};
+  uint64 remaining_samples_{0U};
+};
+
+#endif // ECG_PIPELINE_H
@@ -1,44 +1,526 @@
 #include "ECGSimulation.h"
 
+#include <algorithm>
 #include <cmath>
 
 namespace {
 constexpr float64 seconds_per_minute = 60.0;
 constexpr float64 zero_tolerance = 1e-9;
+// Samples per evaluate() tile: large enough to amortize the per-call kernel
+// dispatch, small enough that the tile stays in L1.
+constexpr std::size_t evaluate_tile_samples = 256U;
+
+// Checkpoint record identification ("ECGS") and layout version.
+constexpr uint32 engine_state_magic = 0x53474345U;
+constexpr uint32 engine_state_version = 5U;
+
+void write_component(Checkpoint_writer *writer, const Ecg_component &c) {
+  writer->write_f64(c.start_time_s);
+  writer->write_f64(c.duration_s);
+  writer->write_bool(c.is_active);
+  writer->write_f64(c.shape_params.direction.x);
+  writer->write_f64(c.shape_params.direction.y);
+  writer->write_f64(c.shape_params.direction.z);
+  writer->write_f64(c.shape_params.scale);
+  writer->write_f64(c.shape_params.center);
+  writer->write_f64(c.shape_params.width);
+  writer->write_f64(c.shape_params.asymmetry);
+}
+
+void read_component(Checkpoint_reader *reader, Ecg_component *c) {
+  c->start_time_s = reader->read_f64();
+  c->duration_s = reader->read_f64();
+  c->is_active = reader->read_bool();
+  c->shape_params.direction.x = reader->read_f64();
+  c->shape_params.direction.y = reader->read_f64();
+  c->shape_params.direction.z = reader->read_f64();
+  c->shape_params.scale = reader->read_f64();
+  c->shape_params.center = reader->read_f64();
+  c->shape_params.width = reader->read_f64();
+  c->shape_params.asymmetry = reader->read_f64();
+}
+
 } // namespace
 
+void allocate_sample_block(Sample_block *block, std::size_t capacity,
+                           std::size_t lead_count) {
+  block->start_index = 0U;
+  block->count = 0U;
+  block->capacity = capacity;
+  block->lead_count = lead_count;
+  block->time_s.assign(capacity, 0.0);
+  block->values.assign(capacity * lead_count, 0.0);
+  block->heart_x.assign(capacity, 0.0);
+  block->heart_y.assign(capacity, 0.0);
+  block->heart_z.assign(capacity, 0.0);
+  block->has_noise_gain = false;
+  block->noise_gain.clear();
+  block->noise.clear();
+  block->has_live_state = false;
+  block->live_state = Live_state{};
+  block->has_checkpoint = false;
+  block->checkpoint.clear();
+}
+
+void allocate_live_block(Sample_block *block) {
+  block->has_noise_gain = false;
+  block->noise_gain.assign(block->capacity, 1.0);
+  block->noise.assign(block->capacity * block->lead_count, 0.0);
+}
+
 ECGSimulationEngine::ECGSimulationEngine(const Ecg_morphology &morphology,
                                          float64 heart_rate_bpm,
                                          float64 sampling_rate_hz)
+    : ECGSimulationEngine(morphology, heart_rate_bpm, sampling_rate_hz,
+                          std::pmr::get_default_resource()) {}
+
+ECGSimulationEngine::ECGSimulationEngine(const Ecg_morphology &morphology,
+                                         float64 heart_rate_bpm,
+                                         float64 sampling_rate_hz,
+                                         std::pmr::memory_resource *resource)
     : morphology_(morphology), heart_rate_bpm_(heart_rate_bpm),
-      sampling_rate_hz_(sampling_rate_hz) {}
+      sampling_rate_hz_(sampling_rate_hz), noise_sources_(resource),
+      evaluate_order_(resource), evaluate_phase_(resource),
+      evaluate_tile_(resource) {}
 
 void ECGSimulationEngine::add_noise_source(
     std::shared_ptr<SignalGenerator> noise) {
+  noise_sources_.push_back(noise.get());
+  owned_noise_sources_.push_back(std::move(noise));
+}
+
+void ECGSimulationEngine::add_noise_source(SignalGenerator *noise) {
   noise_sources_.push_back(noise);
 }
 
 std::vector<Lead_sample>
 ECGSimulationEngine::generate(float64 duration_seconds) {
+  std::vector<Lead_sample> samples(
+      static_cast<std::size_t>(sample_count(duration_seconds)));
+  samples.resize(generate(duration_seconds, samples.data(), samples.size()));
+  return samples;
+}
+
+std::size_t ECGSimulationEngine::generate(float64 duration_seconds,
+                                          Lead_sample *out,
+                                          std::size_t capacity) {
   if (heart_rate_bpm_ <= zero_tolerance ||
       sampling_rate_hz_ <= zero_tolerance ||
       duration_seconds <= zero_tolerance) {
-    return {};
+    return 0U;
   }
 
   const float64 dt = 1.0 / sampling_rate_hz_;
-  const int32 total_samples =
-      static_cast<int32>(duration_seconds * sampling_rate_hz_);
-
-  std::vector<Lead_sample> samples;
-  samples.reserve(static_cast<std::size_t>(total_samples) + 1U);
+  const uint64 total_samples = sample_count(duration_seconds);
+  const std::size_t n = (total_samples < capacity)
+                            ? static_cast<std::size_t>(total_samples)
+                            : capacity;
 
-  for (int32 sample_index = 0; sample_index <= total_samples; ++sample_index) {
+  for (std::size_t sample_index = 0; sample_index < n; ++sample_index) {
     current_time_s_ = static_cast<float64>(sample_index) * dt;
-    samples.push_back(calculate_sample(current_time_s_));
+    out[sample_index] = calculate_sample(current_time_s_);
   }
 
-  return samples;
+  return n;
+}
+
+uint64 ECGSimulationEngine::sample_count(float64 duration_seconds) const {
+  if (sampling_rate_hz_ <= zero_tolerance ||
+      duration_seconds <= zero_tolerance) {
+    return 0U;
+  }
+  return static_cast<uint64>(duration_seconds * sampling_rate_hz_) + 1U;
+}
+
+bool ECGSimulationEngine::evaluate(const float64 *times_s, std::size_t count,
+                                   float64 *leads, std::size_t lead_stride) {
+  if (heart_rate_bpm_ <= zero_tolerance || lead_stride < count) {
+    return false;
+  }
+  for (const auto &noise_gen : noise_sources_) {
+    if (!noise_gen->has_random_access()) {
+      return false;
+    }
+  }
+  // A NaN phase would break the ordering std::sort relies on.
+  for (std::size_t i = 0; i < count; ++i) {
+    if (!std::isfinite(times_s[i])) {
+      return false;
+    }
+  }
+
+  const std::size_t lead_total = lead_matrix_.lead_count();
+  prepare_evaluate_tile();
+  Sample_block &tile = evaluate_tile_;
+
+  // Samples at similar beat phases activate the same components, so the
+  // kernels see coherent branches within a tile.
+  const float64 cycle_duration_s = seconds_per_minute / heart_rate_bpm_;
+  evaluate_phase_.resize(count);
+  evaluate_order_.resize(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    float64 phase = std::fmod(times_s[i], cycle_duration_s);
+    if (phase < 0.0) {
+      phase += cycle_duration_s;
+    }
+    evaluate_phase_[i] = phase;
+    evaluate_order_[i] = i;
+  }
+  std::sort(evaluate_order_.begin(), evaluate_order_.end(),
+            [this](std::size_t a, std::size_t b) {
+              return evaluate_phase_[a] < evaluate_phase_[b];
+            });
+
+  for (std::size_t begin = 0; begin < count; begin += tile.capacity) {
+    const std::size_t n =
+        (count - begin < tile.capacity) ? count - begin : tile.capacity;
+    const std::size_t *order = evaluate_order_.data() + begin;
+    for (std::size_t j = 0; j < n; ++j) {
+      tile.time_s[j] = times_s[order[j]];
+      tile.heart_x[j] = evaluate_phase_[order[j]];
+    }
+    calculate_heart_vectors(&morphology_, morphology_kernel_,
+                            tile.heart_x.data(), n, tile.heart_x.data(),
+                            tile.heart_y.data(), tile.heart_z.data());
+    lead_matrix_.project(tile.heart_x.data(), tile.heart_y.data(),
+                         tile.heart_z.data(), n, tile.values.data(),
+                         tile.capacity);
+
+    if (!noise_sources_.empty()) {
+      std::fill(tile.noise.begin(), tile.noise.end(), 0.0);
+      for (auto &noise_gen : noise_sources_) {
+        noise_gen->add_at_times(tile.time_s.data(), n, tile.noise.data(),
+                                lead_total, tile.capacity);
+      }
+      for (std::size_t k = 0; k < tile.noise.size(); ++k) {
+        tile.values[k] += noise_gain_ * tile.noise[k];
+      }
+    }
+
+    for (std::size_t lead = 0; lead < lead_total; ++lead) {
+      const float64 *column = lead_column(&tile, lead);
+      float64 *out = leads + (lead * lead_stride);
+      for (std::size_t j = 0; j < n; ++j) {
+        out[order[j]] = column[j];
+      }
+    }
+  }
+  return true;
+}
+
+void ECGSimulationEngine::reserve_evaluate(std::size_t count) {
+  evaluate_order_.reserve(count);
+  evaluate_phase_.reserve(count);
+  prepare_evaluate_tile();
+}
+
+void ECGSimulationEngine::prepare_evaluate_tile() {
+  Sample_block &tile = evaluate_tile_;
+  if (tile.capacity != evaluate_tile_samples ||
+      tile.lead_count != lead_matrix_.lead_count()) {
+    allocate_sample_block(&tile, evaluate_tile_samples,
+                          lead_matrix_.lead_count());
+    allocate_live_block(&tile);
+  }
+}
+
+std::size_t ECGSimulationEngine::render_block(Sample_block *block,
+                                              std::size_t count) {
+  block->start_index = next_sample_index_;
+  block->count = 0U;
+
+  block->has_noise_gain = false;
+  block->has_live_state = false;
+
+  if (heart_rate_bpm_ <= zero_tolerance ||
+      sampling_rate_hz_ <= zero_tolerance ||
+      block->lead_count != lead_matrix_.lead_count() ||
+      (beat_tracking_ && block->noise_gain.size() < block->capacity)) {
+    return 0U;
+  }
+
+  const std::size_t n = (count < block->capacity) ? count : block->capacity;
+  const float64 dt = 1.0 / sampling_rate_hz_;
+  float64 cycle_duration_s = seconds_per_minute / heart_rate_bpm_;
+
+  // Pass 1: morphology, one heart vector per sample. The local times are
+  // staged in heart_x, which the kernel overwrites in place. In live mode the
+  // block is evaluated in segments, one per set of parameters.
+  float64 *hx = block->heart_x.data();
+  float64 *hy = block->heart_y.data();
+  float64 *hz = block->heart_z.data();
+  std::size_t segment_begin = 0U;
+  for (std::size_t i = 0; i < n; ++i) {
+    const float64 t = static_cast<float64>(next_sample_index_ + i) * dt;
+    block->time_s[i] = t;
+    if (!beat_tracking_) {
+      hx[i] = std::fmod(t, cycle_duration_s);
+      continue;
+    }
+
+    while (t - beat_start_s_ >= cycle_duration_s) {
+      beat_start_s_ += cycle_duration_s;
+      Live_parameters parameters;
+      if (poll_parameters(&parameters)) {
+        calculate_heart_vectors(&morphology_, morphology_kernel_,
+                                hx + segment_begin, i - segment_begin,
+                                hx + segment_begin, hy + segment_begin,
+                                hz + segment_begin);
+        segment_begin = i;
+        morphology_ = parameters.morphology;
+        heart_rate_bpm_ = parameters.heart_rate_bpm;
+        noise_gain_ = parameters.noise_gain;
+        cycle_duration_s = seconds_per_minute / heart_rate_bpm_;
+      }
+    }
+    hx[i] = t - beat_start_s_;
+    block->noise_gain[i] = noise_gain_;
+  }
+  calculate_heart_vectors(&morphology_, morphology_kernel_, hx + segment_begin,
+                          n - segment_begin, hx + segment_begin,
+                          hy + segment_begin, hz + segment_begin);
+
+  // Pass 2: projection onto every lead, one contiguous column per lead.
+  lead_matrix_.project(block->heart_x.data(), block->heart_y.data(),
+                       block->heart_z.data(), n, block->values.data(),
+                       block->capacity);
+
+  block->count = n;
+  block->has_noise_gain = beat_tracking_;
+  block->has_live_state = beat_tracking_;
+  if (beat_tracking_) {
+    block->live_state = live_state();
+  }
+  next_sample_index_ += n;
+  if (n > 0U) {
+    current_time_s_ = block->time_s[n - 1U];
+  }
+  return n;
+}
+
+void ECGSimulationEngine::apply_noise(Sample_block *block) {
+  if (!block->has_noise_gain) {
+    for (auto &noise_gen : noise_sources_) {
+      noise_gen->add_to_leads(block->time_s.data(), block->count,
+                              block->values.data(), block->lead_count,
+                              block->capacity);
+    }
+    return;
+  }
+  if (noise_sources_.empty()) {
+    return;
+  }
+
+  // Sum the sources separately so the gain scales only the noise.
+  std::fill(block->noise.begin(), block->noise.end(), 0.0);
+  for (auto &noise_gen : noise_sources_) {
+    noise_gen->add_to_leads(block->time_s.data(), block->count,
+                            block->noise.data(), block->lead_count,
+                            block->capacity);
+  }
+  const float64 *gain = block->noise_gain.data();
+  for (std::size_t lead = 0; lead < block->lead_count; ++lead) {
+    float64 *out = lead_column(block, lead);
+    const float64 *noise = block->noise.data() + (lead * block->capacity);
+    for (std::size_t i = 0; i < block->count; ++i) {
+      out[i] += gain[i] * noise[i];
+    }
+  }
+}
+
+void ECGSimulationEngine::set_parameter_channel(
+    const Parameter_channel *channel) {
+  parameter_channel_ = channel;
+  // Snapshots published before the channel was attached apply at the next
+  // beat boundary, like later ones.
+  parameter_version_ = 0U;
+  if (channel != nullptr && !beat_tracking_) {
+    beat_tracking_ = true;
+    seek(next_sample_index_);
+  }
+}
+
+Live_state ECGSimulationEngine::live_state() const {
+  return Live_state{morphology_, heart_rate_bpm_, noise_gain_, beat_start_s_};
+}
+
+void ECGSimulationEngine::seek(uint64 sample_index) {
+  next_sample_index_ = sample_index;
+  if (beat_tracking_ && heart_rate_bpm_ > zero_tolerance &&
+      sampling_rate_hz_ > zero_tolerance) {
+    const float64 t = static_cast<float64>(sample_index) / sampling_rate_hz_;
+    const float64 cycle_duration_s = seconds_per_minute / heart_rate_bpm_;
+    beat_start_s_ = std::floor(t / cycle_duration_s) * cycle_duration_s;
+  }
+}
+
+bool ECGSimulationEngine::poll_parameters(Live_parameters *parameters) {
+  return parameter_channel_ != nullptr &&
+         parameter_channel_->poll(&parameter_version_, parameters) &&
+         parameters->heart_rate_bpm > zero_tolerance;
+}
+
+void ECGSimulationEngine::set_lead_matrix(const Lead_matrix &lead_matrix) {
+  lead_matrix_ = lead_matrix;
+  // An ADC configured for the old lead count is dropped if its per-lead
+  // settings no longer fit.
+  if (adc_.is_configured() &&
+      !adc_.configure(adc_.config(), lead_matrix_.lead_count())) {
+    adc_ = Adc_emulator();
+  }
+}
+
+bool ECGSimulationEngine::set_adc(const Adc_config &config) {
+  return adc_.configure(config, lead_matrix_.lead_count());
+}
+
+void ECGSimulationEngine::quantize(Sample_block *block) {
+  if (!adc_.is_configured()) {
+    return;
+  }
+  adc_.convert(block->values.data(), block->count, block->capacity,
+               block->start_index, &block->adc);
+}
+
+std::size_t ECGSimulationEngine::generate_block(Sample_block *block,
+                                                std::size_t count) {
+  const std::size_t n = render_block(block, count);
+  apply_noise(block);
+  quantize(block);
+  return n;
+}
+
+void ECGSimulationEngine::save_state(Checkpoint_writer *writer) const {
+  save_state(writer, next_sample_index_);
+}
+
+void ECGSimulationEngine::save_state(Checkpoint_writer *writer,
+                                     uint64 resume_sample_index) const {
+  write_state(writer, resume_sample_index, live_state());
+}
+
+void ECGSimulationEngine::save_state(Checkpoint_writer *writer,
+                                     const Sample_block &block) const {
+  write_state(writer, block.start_index + block.count,
+              block.has_live_state ? block.live_state : live_state());
+}
+
+void ECGSimulationEngine::write_state(Checkpoint_writer *writer,
+                                      uint64 resume_sample_index,
+                                      const Live_state &live) const {
+  writer->write_u32(engine_state_magic);
+  writer->write_u32(engine_state_version);
+
+  write_component(writer, live.morphology.p_wave);
+  write_component(writer, live.morphology.qrs_complex);
+  write_component(writer, live.morphology.t_wave);
+
+  writer->write_f64(live.heart_rate_bpm);
+  writer->write_f64(sampling_rate_hz_);
+  // Live mode: the channel itself is not saved, only where the current beat
+  // started and the parameters in effect.
+  writer->write_bool(beat_tracking_);
+  writer->write_f64(live.beat_start_s);
+  writer->write_f64(live.noise_gain);
+  // current_time_s_ is not stored: it follows from the cursor, and in the
+  // pipeline it belongs to the render thread.
+  writer->write_u64(resume_sample_index);
+  writer->write_u32(static_cast<uint32>(morphology_kernel_));
+  writer->write_u64(lead_matrix_.lead_count());
+
+  // Each source is length-prefixed so restore can verify it consumed exactly
+  // its own record.
+  writer->write_u32(static_cast<uint32>(noise_sources_.size()));
+  for (const auto &noise_gen : noise_sources_) {
+    const std::size_t length_position = writer->size();
+    writer->write_u64(0U);
+    noise_gen->save_state(writer);
+    writer->patch_u64(length_position,
+                      writer->size() - length_position - sizeof(uint64));
+  }
+
+  writer->write_bool(adc_.is_configured());
+  if (adc_.is_configured()) {
+    adc_.save_state(writer);
+  }
+}
+
+bool ECGSimulationEngine::restore_state(Checkpoint_reader *reader) {
+  if (reader->read_u32() != engine_state_magic ||
+      reader->read_u32() != engine_state_version) {
+    return false;
+  }
+
+  Ecg_morphology morphology;
+  read_component(reader, &morphology.p_wave);
+  read_component(reader, &morphology.qrs_complex);
+  read_component(reader, &morphology.t_wave);
+
+  const float64 heart_rate_bpm = reader->read_f64();
+  const float64 sampling_rate_hz = reader->read_f64();
+  const bool beat_tracking = reader->read_bool();
+  const float64 beat_start_s = reader->read_f64();
+  const float64 noise_gain = reader->read_f64();
+  const uint64 next_sample_index = reader->read_u64();
+  const uint32 kernel = reader->read_u32();
+  const uint64 lead_count = reader->read_u64();
+  const uint32 noise_count = reader->read_u32();
+
+  if (!reader->ok() || noise_count != noise_sources_.size() ||
+      lead_count != lead_matrix_.lead_count() ||
+      kernel > static_cast<uint32>(morphology_kernel_float32) ||
+      !(heart_rate_bpm > 0.0) || !(sampling_rate_hz > 0.0)) {
+    return false;
+  }
+
+  // Sources and the ADC can only restore in place. Save them first, so that
+  // a record that turns out to be bad part way through is undone.
+  std::vector<uint8> previous;
+  Checkpoint_writer snapshot(&previous);
+  for (const auto &noise_gen : noise_sources_) {
+    noise_gen->save_state(&snapshot);
+  }
+  if (adc_.is_configured()) {
+    adc_.save_state(&snapshot);
+  }
+  if (!restore_generators(reader)) {
+    Checkpoint_reader undo(previous.data(), previous.size());
+    for (auto &noise_gen : noise_sources_) {
+      noise_gen->restore_state(&undo);
+    }
+    if (adc_.is_configured()) {
+      adc_.restore_state(&undo);
+    }
+    return false;
+  }
+
+  morphology_ = morphology;
+  heart_rate_bpm_ = heart_rate_bpm;
+  sampling_rate_hz_ = sampling_rate_hz;
+  beat_tracking_ = beat_tracking;
+  beat_start_s_ = beat_start_s;
+  noise_gain_ = noise_gain;
+  next_sample_index_ = next_sample_index;
+  current_time_s_ =
+      (next_sample_index > 0U)
+          ? static_cast<float64>(next_sample_index - 1U) *
+                (1.0 / sampling_rate_hz_)
+          : 0.0;
+  morphology_kernel_ = static_cast<Morphology_kernel>(kernel);
+  return true;
+}
+
+bool ECGSimulationEngine::restore_generators(Checkpoint_reader *reader) {
+  for (auto &noise_gen : noise_sources_) {
+    const uint64 length = reader->read_u64();
+    const std::size_t before = reader->remaining();
+    if (!reader->ok() || length > before || !noise_gen->restore_state(reader) ||
+        (before - reader->remaining()) != length) {
+      return false;
+    }
+  }
+  return (reader->read_bool() == adc_.is_configured()) &&
+         (!adc_.is_configured() || adc_.restore_state(reader));
 }
 
 Lead_sample ECGSimulationEngine::calculate_sample(float64 t) {
@@ -78,16 +560,12 @@ Lead_sample ECGSimulationEngine::calculate_sample(float64 t) {
   sample.leads[lead_v6_index] =
       project_to_lead(heart_vector, Standard_leads::lead_v6);
 
-  // Apply noise
+  // Apply noise through the block interface, one sample wide, so that a
+  // source producing one value per time for all its channels (e.g.
+  // SpectralNoiseGenerator) advances once per sample, not once per lead.
   for (auto &noise_gen : noise_sources_) {
-    // Some noises are characteristic per lead (White), others common (Wander)
-    // For now, we apply the generator to each lead.
-    // Note: For deterministic noise (Wander), get_value(t) returns same value
-    // for all leads (Common Mode). For random noise (White), get_value(t)
-    // returns NEW random value for each lead.
-    for (double &lead_val : sample.leads) {
-      lead_val += noise_gen->get_value(t);
-    }
+    noise_gen->add_to_leads(&sample.time_s, 1U, sample.leads.data(),
+                            standard_lead_count, 1U);
   }
 
   return sample;
@@ -1,10 +1,15 @@
 #ifndef ECG_SIMULATION_H
 #define ECG_SIMULATION_H
 
+#include "ECGAdc.h"
+#include "ECGCheckpoint.h"
+#include "ECGLeadMatrix.h"
+#include "ECGLiveParameters.h"
 #include "ECGMorphology.h"
 #include "NoiseGenerator.h"
 #include <array>
 #include <memory>
+#include <memory_resource>
 #include <vector>
 
 
@@ -23,29 +28,250 @@ enum Lead_index : std::size_t {
   lead_v6_index
 };
 
+const std::size_t standard_lead_count = 12;
+
+// Parameters in effect in live mode (see set_parameter_channel), with the
+// time at which the current beat started.
+struct Live_state {
+  Ecg_morphology morphology;
+  float64 heart_rate_bpm;
+  float64 noise_gain;
+  float64 beat_start_s;
+};
+
 struct Lead_sample {
   float64 time_s;
-  std::array<float64, 12> leads;
+  std::array<float64, standard_lead_count> leads;
 };
 
+// A block of consecutive samples stored column-wise (one contiguous column per
+// lead) so that stages can stream over it without per-sample allocation.
+// Blocks are sized once and recycled; `count` is the number of valid samples.
+struct Sample_block {
+  Sample_block() = default;
+  // Buffers are allocated from `resource` (e.g. an Ecg_arena).
+  explicit Sample_block(std::pmr::memory_resource *resource)
+      : time_s(resource), values(resource), heart_x(resource),
+        heart_y(resource), heart_z(resource), adc(resource),
+        noise_gain(resource), noise(resource) {}
+
+  uint64 start_index{0U};
+  std::size_t count{0U};
+  std::size_t capacity{0U};
+  std::size_t lead_count{0U};
+  std::pmr::vector<float64> time_s;
+  std::pmr::vector<float64> values; // lead_count columns of `capacity` samples
+
+  // Heart vector components of each sample, kept with the block so that the
+  // render step has scratch space that travels with the data.
+  std::pmr::vector<float64> heart_x;
+  std::pmr::vector<float64> heart_y;
+  std::pmr::vector<float64> heart_z;
+
+  // Quantized codes, filled by ECGSimulationEngine::quantize() when the
+  // engine has an ADC stage. Allocated separately (allocate_adc_block).
+  Adc_block adc;
+
+  // Live mode only (allocate_live_block): the noise gain of each sample, and
+  // scratch for the noise before the gain is applied.
+  bool has_noise_gain{false};
+  std::pmr::vector<float64> noise_gain;
+  std::pmr::vector<float64> noise; // lead_count columns of `capacity` samples
+
+  // Live parameters as of the end of this block, so that a checkpoint taken
+  // downstream does not read them from the engine while it renders ahead.
+  bool has_live_state{false};
+  Live_state live_state{};
+
+  // Engine state as of the end of this block, attached by the pipeline when
+  // a checkpoint is due and persisted once the block has been written.
+  bool has_checkpoint{false};
+  std::vector<uint8> checkpoint;
+};
+
+void allocate_sample_block(Sample_block *block, std::size_t capacity,
+                           std::size_t lead_count);
+
+// Size the live-mode buffers of a block already allocated for its capacity
+// and lead count.
+void allocate_live_block(Sample_block *block);
+
+inline float64 *lead_column(Sample_block *block, std::size_t lead) {
+  return block->values.data() + (lead * block->capacity);
+}
+
+inline const float64 *lead_column(const Sample_block *block,
+                                  std::size_t lead) {
+  return block->values.data() + (lead * block->capacity);
+}
+
 class ECGSimulationEngine {
 public:
   ECGSimulationEngine(const Ecg_morphology &morphology, float64 heart_rate_bpm,
                       float64 sampling_rate_hz);
+  // The engine's own buffers (noise source list, evaluate() scratch) come
+  // from `resource`, e.g. an Ecg_arena the engine itself was created in.
+  ECGSimulationEngine(const Ecg_morphology &morphology, float64 heart_rate_bpm,
+                      float64 sampling_rate_hz,
+                      std::pmr::memory_resource *resource);
 
   // Add a noise source to the simulation
   void add_noise_source(std::shared_ptr<SignalGenerator> noise);
+  // Non-owning: `noise` (e.g. made with Ecg_arena::create()) must outlive
+  // the engine.
+  void add_noise_source(SignalGenerator *noise);
+  void clear_noise_sources() {
+    noise_sources_.clear();
+    owned_noise_sources_.clear();
+  }
+
+  // Replace the morphology; the stream cursor is unchanged.
+  void set_morphology(const Ecg_morphology &morphology) {
+    morphology_ = morphology;
+  }
+
+  // --- Live parameters ---
+  // Attaching a channel switches the block path to live mode: beats are
+  // tracked explicitly instead of as fmod(t, cycle), and at each beat
+  // boundary render_block() polls the channel and, if a new snapshot was
+  // published, renders the next beat with its morphology, rate and noise
+  // gain. Beats are never changed part-way through, so there is no step in
+  // the waveform. Polling does not block (see Parameter_channel); a snapshot
+  // whose publication overlaps the poll is picked up at the following beat.
+  // A snapshot with a non-positive rate is ignored. Blocks rendered in live
+  // mode need allocate_live_block(). Passing nullptr detaches the channel
+  // but stays in live mode; generate() is not affected.
+  void set_parameter_channel(const Parameter_channel *channel);
+  bool is_live() const { return beat_tracking_; }
+  Live_state live_state() const;
+
+  float64 heart_rate_bpm() const { return heart_rate_bpm_; }
+  float64 sampling_rate_hz() const { return sampling_rate_hz_; }
 
   // Generate samples for a given duration
   std::vector<Lead_sample> generate(float64 duration_seconds);
+  // The same samples written to `out`, without allocating; at most
+  // `capacity` are written. Returns the number written.
+  std::size_t generate(float64 duration_seconds, Lead_sample *out,
+                       std::size_t capacity);
+
+  // Number of samples generate() produces for a duration (endpoint included).
+  uint64 sample_count(float64 duration_seconds) const;
+
+  // --- Random access ---
+  // Evaluate the signal at arbitrary times, in any order (e.g. for jittered
+  // or irregular sampling): the clean signal with the current parameters,
+  // beats counted from t = 0 as in generate(), plus every noise source
+  // through add_at_times(), scaled by the noise gain. Lead l at times_s[i]
+  // goes to leads[l * lead_stride + i]. Times are sorted by beat phase and
+  // evaluated in tiles with the render_block() kernels; the stream cursor
+  // and the sources' streaming state are not changed. Returns false, with
+  // `leads` untouched, for a non-positive rate, lead_stride < count, a
+  // non-finite time, or a noise source without has_random_access().
+  bool evaluate(const float64 *times_s, std::size_t count, float64 *leads,
+                std::size_t lead_stride);
+  // Size the evaluate() scratch for up to `count` times, so that later calls
+  // do not allocate.
+  void reserve_evaluate(std::size_t count);
+
+  // --- Block streaming ---
+  // The block path walks the same sample grid as generate(), but keeps a
+  // cursor so a long record can be produced in bounded memory. Rendering and
+  // noise injection are separate so they can run as pipeline stages; calling
+  // both in order is equivalent to generate_block().
+
+  // Fill `block` with up to `count` clean samples starting at the cursor and
+  // advance the cursor. Returns the number of samples rendered.
+  std::size_t render_block(Sample_block *block, std::size_t count);
+
+  // Add every noise source to the samples already rendered into `block`.
+  void apply_noise(Sample_block *block);
+
+  // ADC emulation stage, run after noise injection. Configure it after the
+  // lead matrix; returns false for an invalid configuration.
+  bool set_adc(const Adc_config &config);
+  bool has_adc() const { return adc_.is_configured(); }
+  const Adc_config &adc_config() const { return adc_.config(); }
+
+  // Quantize the block's samples into block->adc, which must be allocated
+  // for adc_config(). Does nothing without an ADC stage.
+  void quantize(Sample_block *block);
+
+  // Size per-block scratch (the ADC's dither buffer) for blocks of up to
+  // `capacity` samples, so that the first block does not allocate. Call it
+  // after set_adc().
+  void reserve_blocks(std::size_t capacity) { adc_.reserve(capacity); }
+
+  // render_block(), apply_noise() and, with an ADC stage, quantize().
+  std::size_t generate_block(Sample_block *block, std::size_t count);
+
+  // Leads rendered by the block path (standard 12 by default). Blocks passed
+  // to render_block() must have lead_count() columns; generate() and
+  // Lead_sample always use the standard 12 leads.
+  void set_lead_matrix(const Lead_matrix &lead_matrix);
+  const Lead_matrix &lead_matrix() const { return lead_matrix_; }
+  std::size_t lead_count() const { return lead_matrix_.lead_count(); }
+
+  // Select the morphology evaluator used by render_block(). generate()
+  // always uses the reference path.
+  void set_morphology_kernel(Morphology_kernel kernel) {
+    morphology_kernel_ = kernel;
+  }
+
+  // In live mode, the beat containing the sample is assumed to have started
+  // at a multiple of the current cycle length.
+  void seek(uint64 sample_index);
+  uint64 next_sample_index() const { return next_sample_index_; }
+
+  // --- Checkpointing ---
+  // Serialize morphology, rates, the stream cursor and every noise source so
+  // that restore_state() continues the stream bit-identically. The variant
+  // taking `resume_sample_index` is for callers (the pipeline) whose render
+  // cursor has run ahead of the last fully processed block.
+  void save_state(Checkpoint_writer *writer) const;
+  void save_state(Checkpoint_writer *writer, uint64 resume_sample_index) const;
+  // Resume after `block`, with the live parameters it carries if any.
+  void save_state(Checkpoint_writer *writer, const Sample_block &block) const;
+
+  // The engine must already hold the same noise sources, in the same order,
+  // as the engine that was saved; their parameters and state are overwritten.
+  // On failure the engine, its sources and its ADC are left unchanged.
+  bool restore_state(Checkpoint_reader *reader);
 
 private:
   Ecg_morphology morphology_;
   float64 heart_rate_bpm_;
   float64 sampling_rate_hz_;
   double current_time_s_{0.0};
+  uint64 next_sample_index_{0};
+  Morphology_kernel morphology_kernel_{morphology_kernel_reference};
+  Lead_matrix lead_matrix_{Lead_matrix::standard_12()};
+  Adc_emulator adc_;
+
+  // Sources in order; the shared ones are also kept alive here.
+  std::pmr::vector<SignalGenerator *> noise_sources_;
+  std::vector<std::shared_ptr<SignalGenerator>> owned_noise_sources_;
+
+  // evaluate() scratch, grown on demand: sort order, beat phases, and one
+  // tile of samples in sorted order.
+  std::pmr::vector<std::size_t> evaluate_order_;
+  std::pmr::vector<float64> evaluate_phase_;
+  Sample_block evaluate_tile_;
+
+  const Parameter_channel *parameter_channel_{nullptr};
+  uint64 parameter_version_{0U};
+  bool beat_tracking_{false};
+  float64 noise_gain_{1.0};
+  float64 beat_start_s_{0.0};
+
+  void prepare_evaluate_tile();
 
-  std::vector<std::shared_ptr<SignalGenerator>> noise_sources_;
+  // Fetch a newly published, valid snapshot; returns false if there is none.
+  bool poll_parameters(Live_parameters *parameters);
+  void write_state(Checkpoint_writer *writer, uint64 resume_sample_index,
+                   const Live_state &live) const;
+  // Restore the noise sources and the ADC in place; may stop part way.
+  bool restore_generators(Checkpoint_reader *reader);
 
   // Helper to calculate one sample at absolute time t
   Lead_sample calculate_sample(float64 t);
@@ -0,0 +1,416 @@
+#include "ECGSpectralNoise.h"
+
+#include "ECGCheckpoint.h"
+#include "ECGMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+// Rule 151: Avoid magic numbers.
+const float64 two_pi = 2.0 * pi_value;
+const std::size_t min_fft_size = 64U;
+const float64 unit_interval_scale = 1.0 / 9007199254740992.0; // 2^-53
+
+// Presets. EMG occupies roughly 20-250 Hz; electrode motion artifacts sit
+// in the 0.5-10 Hz band where they overlap the P and T waves.
+const float64 colored_noise_low_hz = 0.05;
+const float64 emg_low_hz = 20.0;
+const float64 emg_high_hz = 250.0;
+const float64 emg_burst_rate_hz = 0.3;
+const float64 emg_burst_duration_s = 0.5;
+const float64 emg_burst_floor = 0.1;
+const float64 emg_burst_ramp_s = 0.05;
+const float64 motion_alpha = 1.0;
+const float64 motion_low_hz = 0.5;
+const float64 motion_high_hz = 10.0;
+const float64 motion_burst_rate_hz = 0.1;
+const float64 motion_burst_duration_s = 1.0;
+const float64 motion_burst_ramp_s = 0.1;
+
+// splitmix64: small, fast, and its whole state is one word, which keeps the
+// checkpoint format and cross-platform reproducibility simple.
+uint64 splitmix64(uint64 *state) {
+  uint64 z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// Uniform on the open interval (0, 1).
+float64 next_open_uniform(uint64 *state) {
+  return (static_cast<float64>(splitmix64(state) >> 11) + 0.5) *
+         unit_interval_scale;
+}
+
+std::size_t round_up_to_power_of_two(std::size_t n) {
+  std::size_t size = min_fft_size;
+  while (size < n) {
+    size *= 2U;
+  }
+  return size;
+}
+
+void write_samples(Checkpoint_writer *writer,
+                   const std::vector<float64> &values) {
+  writer->write_bytes(values.data(), values.size() * sizeof(float64));
+}
+
+bool read_samples(Checkpoint_reader *reader, std::vector<float64> *values) {
+  return reader->read_bytes(values->data(), values->size() * sizeof(float64));
+}
+} // namespace
+
+Spectral_noise_config create_colored_noise_config(float64 alpha,
+                                                  float64 rms_mv) {
+  Spectral_noise_config config;
+  config.rms_mv = rms_mv;
+  config.alpha = alpha;
+  config.low_hz = colored_noise_low_hz;
+  return config;
+}
+
+Spectral_noise_config create_emg_noise_config(float64 rms_mv) {
+  Spectral_noise_config config;
+  config.rms_mv = rms_mv;
+  config.alpha = 0.0;
+  config.low_hz = emg_low_hz;
+  config.high_hz = emg_high_hz;
+  config.bursts = true;
+  config.burst_rate_hz = emg_burst_rate_hz;
+  config.burst_duration_s = emg_burst_duration_s;
+  config.burst_floor = emg_burst_floor;
+  config.burst_ramp_s = emg_burst_ramp_s;
+  return config;
+}
+
+Spectral_noise_config create_motion_artifact_config(float64 rms_mv) {
+  Spectral_noise_config config;
+  config.rms_mv = rms_mv;
+  config.alpha = motion_alpha;
+  config.low_hz = motion_low_hz;
+  config.high_hz = motion_high_hz;
+  config.bursts = true;
+  config.burst_rate_hz = motion_burst_rate_hz;
+  config.burst_duration_s = motion_burst_duration_s;
+  config.burst_floor = 0.0;
+  config.burst_ramp_s = motion_burst_ramp_s;
+  return config;
+}
+
+SpectralNoiseGenerator::SpectralNoiseGenerator(
+    const Spectral_noise_config &config, double sampling_rate_hz,
+    std::size_t channel_count)
+    : config_(config), sampling_rate_hz_(sampling_rate_hz),
+      channel_count_(std::max<std::size_t>(channel_count, 1U)) {
+  config_.fft_size = round_up_to_power_of_two(config.fft_size);
+  config_.correlation = std::min(std::max(config.correlation, 0.0), 1.0);
+  plan_.configure(config_.fft_size);
+  hop_ = config_.fft_size / 2U;
+
+  common_weight_ = std::sqrt(config_.correlation);
+  independent_weight_ = std::sqrt(1.0 - config_.correlation);
+  has_common_ = config_.correlation > 0.0;
+  has_independent_ = config_.correlation < 1.0;
+
+  // Each stream starts from a hashed position of the seed sequence, so the
+  // streams do not overlap in practice.
+  uint64 seeder = config_.seed;
+  const std::size_t stream_count =
+      (has_common_ ? 1U : 0U) + (has_independent_ ? channel_count_ : 0U);
+  streams_.resize(stream_count);
+  for (auto &stream : streams_) {
+    stream.rng_state = splitmix64(&seeder);
+    stream.has_spare = false;
+    stream.spare = 0.0;
+    stream.tail.assign(hop_, 0.0);
+    stream.hop.assign(hop_, 0.0);
+  }
+  channel_hop_.assign(channel_count_ * hop_, 0.0);
+  position_ = hop_; // the first read synthesizes a hop
+
+  envelope_rng_state_ = splitmix64(&seeder);
+  in_burst_ = true; // the first envelope step starts a gap
+  phase_samples_left_ = 0U;
+  envelope_level_ = config_.burst_floor;
+  envelope_step_ =
+      (config_.burst_ramp_s > 0.0 && sampling_rate_hz_ > 0.0)
+          ? 1.0 - std::exp(-1.0 / (config_.burst_ramp_s * sampling_rate_hz_))
+          : 1.0;
+  envelope_.assign(hop_, 1.0);
+
+  work_re_.assign(config_.fft_size, 0.0);
+  work_im_.assign(config_.fft_size, 0.0);
+  design_filter(sampling_rate_hz);
+}
+
+float64 SpectralNoiseGenerator::target_psd(float64 frequency_hz) const {
+  if (frequency_hz <= 0.0) {
+    return 0.0;
+  }
+
+  const auto &points = config_.psd_points;
+  if (!points.empty()) {
+    if (frequency_hz < points.front().first ||
+        frequency_hz > points.back().first) {
+      return 0.0;
+    }
+    const auto upper = std::lower_bound(
+        points.begin(), points.end(), frequency_hz,
+        [](const std::pair<float64, float64> &point, float64 f) {
+          return point.first < f;
+        });
+    if (upper == points.begin()) {
+      return upper->second;
+    }
+    const auto lower = upper - 1;
+    const float64 span = upper->first - lower->first;
+    const float64 fraction =
+        (span > 0.0) ? (frequency_hz - lower->first) / span : 0.0;
+    return lower->second + (fraction * (upper->second - lower->second));
+  }
+
+  float64 psd = std::pow(frequency_hz, -config_.alpha);
+  if (config_.low_hz > 0.0) {
+    const float64 r = std::pow(frequency_hz / config_.low_hz, 4.0);
+    psd *= r / (1.0 + r);
+  }
+  if (config_.high_hz > 0.0) {
+    const float64 r = std::pow(frequency_hz / config_.high_hz, 4.0);
+    psd *= 1.0 / (1.0 + r);
+  }
+  return psd;
+}
+
+void SpectralNoiseGenerator::design_filter(float64 sampling_rate_hz) {
+  const std::size_t n = config_.fft_size;
+  taps_.assign(hop_, 0.0);
+  response_re_.assign(n, 0.0);
+  response_im_.assign(n, 0.0);
+  if (sampling_rate_hz <= 0.0) {
+    return; // silent
+  }
+
+  // Frequency sampling: the square root of the PSD on the transform grid,
+  // as a real, even spectrum whose inverse is a zero-phase impulse response.
+  std::fill(work_im_.begin(), work_im_.end(), 0.0);
+  for (std::size_t k = 0; k <= n / 2U; ++k) {
+    const float64 f =
+        static_cast<float64>(k) * sampling_rate_hz / static_cast<float64>(n);
+    const float64 amplitude = std::sqrt(std::max(target_psd(f), 0.0));
+    work_re_[k] = amplitude;
+    work_re_[(n - k) % n] = amplitude;
+  }
+  plan_.inverse(work_re_.data(), work_im_.data());
+
+  // Center the response in hop_ taps under a Hann window, then scale to
+  // unit energy times the RMS: unit-variance white input then yields
+  // exactly rms_mv.
+  const std::size_t center = hop_ / 2U;
+  float64 energy = 0.0;
+  for (std::size_t m = 0; m < hop_; ++m) {
+    const float64 window =
+        0.5 - (0.5 * std::cos(two_pi * static_cast<float64>(m) /
+                              static_cast<float64>(hop_)));
+    taps_[m] = work_re_[(m + n - center) % n] * window;
+    energy += taps_[m] * taps_[m];
+  }
+  if (energy <= 0.0) {
+    std::fill(taps_.begin(), taps_.end(), 0.0);
+    return;
+  }
+  const float64 scale = config_.rms_mv / std::sqrt(energy);
+  for (auto &tap : taps_) {
+    tap *= scale;
+  }
+
+  std::copy(taps_.begin(), taps_.end(), response_re_.begin());
+  plan_.forward(response_re_.data(), response_im_.data());
+}
+
+float64 SpectralNoiseGenerator::next_gaussian(Gaussian_stream *stream) {
+  // Box-Muller, keeping the second value of each pair.
+  if (stream->has_spare) {
+    stream->has_spare = false;
+    return stream->spare;
+  }
+  const float64 u1 = next_open_uniform(&stream->rng_state);
+  const float64 u2 = next_open_uniform(&stream->rng_state);
+  const float64 radius = std::sqrt(-2.0 * std::log(u1));
+  stream->spare = radius * std::sin(two_pi * u2);
+  stream->has_spare = true;
+  return radius * std::cos(two_pi * u2);
+}
+
+void SpectralNoiseGenerator::filter_pair(Gaussian_stream *a,
+                                         Gaussian_stream *b) {
+  // The filter is real, so filtering a + i b yields filter(a) + i filter(b):
+  // one complex transform serves two streams.
+  const std::size_t n = config_.fft_size;
+  for (std::size_t i = 0; i < hop_; ++i) {
+    work_re_[i] = next_gaussian(a);
+  }
+  for (std::size_t i = 0; i < hop_; ++i) {
+    work_im_[i] = (b != nullptr) ? next_gaussian(b) : 0.0;
+  }
+  std::fill(work_re_.begin() + hop_, work_re_.end(), 0.0);
+  std::fill(work_im_.begin() + hop_, work_im_.end(), 0.0);
+
+  plan_.forward(work_re_.data(), work_im_.data());
+  for (std::size_t k = 0; k < n; ++k) {
+    const float64 re = work_re_[k];
+    const float64 im = work_im_[k];
+    work_re_[k] = (re * response_re_[k]) - (im * response_im_[k]);
+    work_im_[k] = (re * response_im_[k]) + (im * response_re_[k]);
+  }
+  plan_.inverse(work_re_.data(), work_im_.data());
+
+  // Overlap-add: hop_ inputs convolved with hop_ taps span 2 * hop_ - 1
+  // outputs, so the second half carries into the next hop only.
+  for (std::size_t i = 0; i < hop_; ++i) {
+    a->hop[i] = work_re_[i] + a->tail[i];
+    a->tail[i] = work_re_[hop_ + i];
+  }
+  if (b != nullptr) {
+    for (std::size_t i = 0; i < hop_; ++i) {
+      b->hop[i] = work_im_[i] + b->tail[i];
+      b->tail[i] = work_im_[hop_ + i];
+    }
+  }
+}
+
+void SpectralNoiseGenerator::fill_envelope() {
+  for (std::size_t i = 0; i < hop_; ++i) {
+    if (phase_samples_left_ == 0U) {
+      in_burst_ = !in_burst_;
+      const float64 mean_s =
+          in_burst_ ? config_.burst_duration_s
+                    : ((config_.burst_rate_hz > 0.0)
+                           ? 1.0 / config_.burst_rate_hz
+                           : std::numeric_limits<float64>::infinity());
+      const float64 length = -std::log(next_open_uniform(&envelope_rng_state_)) *
+                             mean_s * sampling_rate_hz_;
+      phase_samples_left_ =
+          (length >= static_cast<float64>(std::numeric_limits<uint64>::max()))
+              ? std::numeric_limits<uint64>::max()
+              : std::max<uint64>(static_cast<uint64>(std::llround(length)), 1U);
+    }
+    --phase_samples_left_;
+    const float64 target = in_burst_ ? 1.0 : config_.burst_floor;
+    envelope_level_ += (target - envelope_level_) * envelope_step_;
+    envelope_[i] = envelope_level_;
+  }
+}
+
+void SpectralNoiseGenerator::refill() {
+  for (std::size_t s = 0; s < streams_.size(); s += 2U) {
+    filter_pair(&streams_[s],
+                (s + 1U < streams_.size()) ? &streams_[s + 1U] : nullptr);
+  }
+  if (config_.bursts) {
+    fill_envelope();
+  }
+
+  const std::size_t first_independent = has_common_ ? 1U : 0U;
+  for (std::size_t c = 0; c < channel_count_; ++c) {
+    float64 *out = channel_hop_.data() + (c * hop_);
+    const float64 *common = has_common_ ? streams_[0].hop.data() : nullptr;
+    const float64 *independent =
+        has_independent_ ? streams_[first_independent + c].hop.data()
+                         : nullptr;
+    for (std::size_t i = 0; i < hop_; ++i) {
+      float64 value = 0.0;
+      if (common != nullptr) {
+        value += common_weight_ * common[i];
+      }
+      if (independent != nullptr) {
+        value += independent_weight_ * independent[i];
+      }
+      out[i] = config_.bursts ? value * envelope_[i] : value;
+    }
+  }
+  position_ = 0U;
+}
+
+double SpectralNoiseGenerator::get_value(double /*time_s*/) {
+  if (position_ == hop_) {
+    refill();
+  }
+  return channel_hop_[position_++];
+}
+
+void SpectralNoiseGenerator::add_to_leads(const double * /*times_s*/,
+                                          std::size_t count, double *leads,
+                                          std::size_t lead_count,
+                                          std::size_t lead_stride) {
+  std::size_t done = 0U;
+  while (done < count) {
+    if (position_ == hop_) {
+      refill();
+    }
+    const std::size_t n = std::min(count - done, hop_ - position_);
+    for (std::size_t lead = 0; lead < lead_count; ++lead) {
+      const float64 *src =
+          channel_hop_.data() + ((lead % channel_count_) * hop_) + position_;
+      float64 *dst = leads + (lead * lead_stride) + done;
+      for (std::size_t i = 0; i < n; ++i) {
+        dst[i] += src[i];
+      }
+    }
+    position_ += n;
+    done += n;
+  }
+}
+
+void SpectralNoiseGenerator::save_state(Checkpoint_writer *writer) const {
+  // Layout identification only; the filter follows from the configuration.
+  writer->write_u64(config_.fft_size);
+  writer->write_u64(channel_count_);
+  writer->write_u64(streams_.size());
+
+  for (const auto &stream : streams_) {
+    writer->write_u64(stream.rng_state);
+    writer->write_bool(stream.has_spare);
+    writer->write_f64(stream.spare);
+    write_samples(writer, stream.tail);
+  }
+  write_samples(writer, channel_hop_);
+  writer->write_u64(position_);
+
+  writer->write_u64(envelope_rng_state_);
+  writer->write_bool(in_burst_);
+  writer->write_u64(phase_samples_left_);
+  writer->write_f64(envelope_level_);
+}
+
+bool SpectralNoiseGenerator::restore_state(Checkpoint_reader *reader) {
+  if (reader->read_u64() != config_.fft_size ||
+      reader->read_u64() != channel_count_ ||
+      reader->read_u64() != streams_.size() || !reader->ok()) {
+    return false;
+  }
+
+  for (auto &stream : streams_) {
+    stream.rng_state = reader->read_u64();
+    stream.has_spare = reader->read_bool();
+    stream.spare = reader->read_f64();
+    if (!read_samples(reader, &stream.tail)) {
+      return false;
+    }
+  }
+  if (!read_samples(reader, &channel_hop_)) {
+    return false;
+  }
+  const uint64 position = reader->read_u64();
+
+  envelope_rng_state_ = reader->read_u64();
+  in_burst_ = reader->read_bool();
+  phase_samples_left_ = reader->read_u64();
+  envelope_level_ = reader->read_f64();
+  if (!reader->ok() || position > hop_) {
+    return false;
+  }
+  position_ = static_cast<std::size_t>(position);
+  return true;
+}
@@ -0,0 +1,142 @@
+#ifndef ECG_SPECTRAL_NOISE_H
+#define ECG_SPECTRAL_NOISE_H
+
+#include "ECGFft.h"
+#include "SignalGenerator.h"
+#include "Types.h"
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+struct Spectral_noise_config {
+  float64 rms_mv{0.01}; // RMS of the noise at full envelope gain
+
+  // Target power spectral density: f^-alpha between low_hz and high_hz, with
+  // fourth-order roll-off at both edges. high_hz <= 0 means no upper edge.
+  float64 alpha{1.0};
+  float64 low_hz{0.05};
+  float64 high_hz{0.0};
+
+  // Tabulated PSD as {frequency Hz, relative density} pairs in increasing
+  // frequency, interpolated linearly and zero outside the table. When not
+  // empty it replaces the parametric shape above.
+  std::vector<std::pair<float64, float64>> psd_points;
+
+  // Transform length of the overlap-add filter; rounded up to a power of
+  // two. The shaping filter has fft_size / 2 taps, so spectral detail below
+  // about 2 * sampling_rate / fft_size is smoothed out.
+  std::size_t fft_size{4096U};
+
+  uint64 seed{1U};
+
+  // Correlation between channels: 1 gives every channel the same noise, 0
+  // independent noise, values in between mix a common and a per-channel
+  // component.
+  float64 correlation{1.0};
+
+  // Burst envelope, e.g. for muscle (EMG) activity: bursts of mean length
+  // burst_duration_s separated by gaps of mean length 1 / burst_rate_hz,
+  // both exponentially distributed. The gain is 1 inside a burst and
+  // burst_floor between bursts, and moves between the two with time
+  // constant burst_ramp_s.
+  bool bursts{false};
+  float64 burst_rate_hz{0.5};
+  float64 burst_duration_s{0.3};
+  float64 burst_floor{0.0};
+  float64 burst_ramp_s{0.02};
+};
+
+// Presets.
+Spectral_noise_config create_colored_noise_config(float64 alpha,
+                                                  float64 rms_mv);
+Spectral_noise_config create_emg_noise_config(float64 rms_mv);
+Spectral_noise_config create_motion_artifact_config(float64 rms_mv);
+
+/**
+ * @brief Gaussian noise with a prescribed power spectrum, synthesized in
+ * blocks.
+ *
+ * Gaussian white noise is filtered by a windowed FIR filter whose amplitude
+ * response is the square root of the target PSD, using FFT convolution with
+ * overlap-add, so each hop of fft_size / 2 samples costs O(n log n) and
+ * consecutive hops join without seams. Two real streams share each complex
+ * transform.
+ *
+ * The generator is sequential like WhiteNoiseGenerator: every get_value()
+ * call returns the next sample of channel 0 and the times are not used.
+ * add_to_leads() advances all channels by one sample per sample; lead l
+ * receives channel l % channel_count. Use one entry point per instance;
+ * ECGSimulationEngine only uses add_to_leads(), in every generation path.
+ */
+class SpectralNoiseGenerator : public SignalGenerator {
+public:
+  SpectralNoiseGenerator(const Spectral_noise_config &config,
+                         double sampling_rate_hz,
+                         std::size_t channel_count = 1U);
+
+  double get_value(double time_s) override;
+
+  void add_to_leads(const double *times_s, std::size_t count, double *leads,
+                    std::size_t lead_count, std::size_t lead_stride) override;
+
+  // The restoring generator must have been constructed with the same
+  // configuration, sampling rate and channel count.
+  void save_state(Checkpoint_writer *writer) const override;
+  bool restore_state(Checkpoint_reader *reader) override;
+
+  std::size_t channel_count() const { return channel_count_; }
+  std::size_t hop_size() const { return hop_; }
+
+  // Impulse response of the shaping filter (fft_size / 2 taps), scaled to
+  // the configured RMS.
+  const std::vector<float64> &filter_taps() const { return taps_; }
+
+private:
+  struct Gaussian_stream {
+    uint64 rng_state;
+    bool has_spare;
+    float64 spare;
+    std::vector<float64> tail; // overlap carried into the next hop
+    std::vector<float64> hop;  // filtered output of the current hop
+  };
+
+  void design_filter(float64 sampling_rate_hz);
+  float64 target_psd(float64 frequency_hz) const;
+  float64 next_gaussian(Gaussian_stream *stream);
+  void filter_pair(Gaussian_stream *a, Gaussian_stream *b);
+  void fill_envelope();
+  void refill();
+
+  Spectral_noise_config config_;
+  float64 sampling_rate_hz_;
+  std::size_t channel_count_;
+  std::size_t hop_;           // samples per overlap-add hop
+  float64 common_weight_;     // sqrt(correlation)
+  float64 independent_weight_; // sqrt(1 - correlation)
+  bool has_common_;
+  bool has_independent_;
+
+  Fft_plan plan_;
+  std::vector<float64> taps_;
+  std::vector<float64> response_re_; // filter spectrum
+  std::vector<float64> response_im_;
+  std::vector<float64> work_re_;     // transform scratch
+  std::vector<float64> work_im_;
+
+  // Stream 0 is the common component when there is one, followed by one
+  // stream per channel for the independent components.
+  std::vector<Gaussian_stream> streams_;
+  std::vector<float64> channel_hop_; // channel_count_ x hop_, final output
+  std::size_t position_;             // next unread sample in the hop
+
+  // Burst envelope state.
+  uint64 envelope_rng_state_;
+  bool in_burst_;
+  uint64 phase_samples_left_;
+  float64 envelope_level_;
+  float64 envelope_step_; // per-sample smoothing coefficient
+  std::vector<float64> envelope_;
+};
+
+#endif // ECG_SPECTRAL_NOISE_H
@@ -1,17 +1,47 @@
 #ifndef NOISE_GENERATOR_H
 #define NOISE_GENERATOR_H
 
+#include "ECGCheckpoint.h"
 #include "SignalGenerator.h"
+#include <cstring>
+#include <memory_resource>
 #include <random>
 #include <vector>
 
+/**
+ * @brief Uniform value in [-1, 1) that depends only on a seed, a time and a
+ * lead: the random-access counterpart of a stream of uniform draws.
+ */
+inline double hashed_uniform(uint64 seed, double time_s, std::size_t lead) {
+  const double t = time_s + 0.0; // -0.0 and 0.0 hash alike
+  uint64 bits = 0U;
+  std::memcpy(&bits, &t, sizeof(bits));
+  // Two rounds of the splitmix64 finalizer over the combined key.
+  uint64 z = seed ^ (bits * 0x9E3779B97F4A7C15ULL) ^
+             (static_cast<uint64>(lead) * 0xD1B54A32D192ED03ULL);
+  for (int32 round = 0; round < 2; ++round) {
+    z += 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+  }
+  const double unit =
+      static_cast<double>(z >> 11) / 9007199254740992.0; // 2^53
+  return (2.0 * unit) - 1.0;
+}
+
 /**
  * @brief Generates Gaussian white noise (thermal/electronic noise).
  */
 class WhiteNoiseGenerator : public SignalGenerator {
 public:
   explicit WhiteNoiseGenerator(double amplitude)
-      : amplitude_(amplitude), distribution_(-1.0, 1.0) {}
+      : WhiteNoiseGenerator(amplitude, std::random_device{}()) {}
+
+  // Reproducible sequence, e.g. for tests and resumable runs.
+  WhiteNoiseGenerator(double amplitude, std::mt19937::result_type seed)
+      : amplitude_(amplitude), seed_(seed), generator_(seed),
+        distribution_(-1.0, 1.0) {}
 
   double get_value(double time_s) override {
     // We use a simple approximation or standard deviation.
@@ -21,9 +51,37 @@ public:
     return distribution_(generator_) * amplitude_;
   }
 
+  // Random access hashes the time instead of drawing from the stream: the
+  // same distribution, but a different realization from add_to_leads().
+  bool has_random_access() const override { return true; }
+
+  void add_at_times(const double *times_s, std::size_t count, double *leads,
+                    std::size_t lead_count, std::size_t lead_stride) override {
+    for (std::size_t lead = 0; lead < lead_count; ++lead) {
+      double *column = leads + (lead * lead_stride);
+      for (std::size_t i = 0; i < count; ++i) {
+        column[i] += hashed_uniform(seed_, times_s[i], lead) * amplitude_;
+      }
+    }
+  }
+
+  void save_state(Checkpoint_writer *writer) const override {
+    writer->write_f64(amplitude_);
+    writer->write_u64(seed_);
+    write_mt19937(writer, generator_);
+  }
+
+  bool restore_state(Checkpoint_reader *reader) override {
+    amplitude_ = reader->read_f64();
+    seed_ = reader->read_u64();
+    distribution_.reset();
+    return read_mt19937(reader, &generator_);
+  }
+
 private:
   double amplitude_;
-  std::mt19937 generator_{std::random_device{}()};
+  uint64 seed_;
+  std::mt19937 generator_;
   std::uniform_real_distribution<double> distribution_;
 };
 
@@ -42,6 +100,21 @@ public:
            std::sin(2.0 * 3.14159265359 * frequency_ * time_s + phase_rad_);
   }
 
+  bool has_random_access() const override { return true; }
+
+  void save_state(Checkpoint_writer *writer) const override {
+    writer->write_f64(amplitude_);
+    writer->write_f64(frequency_);
+    writer->write_f64(phase_rad_);
+  }
+
+  bool restore_state(Checkpoint_reader *reader) override {
+    amplitude_ = reader->read_f64();
+    frequency_ = reader->read_f64();
+    phase_rad_ = reader->read_f64();
+    return reader->ok();
+  }
+
 private:
   double amplitude_;
   double frequency_;
@@ -71,6 +144,33 @@ public:
     return (val / oscillators_.size()) * amplitude_;
   }
 
+  bool has_random_access() const override { return true; }
+
+  void save_state(Checkpoint_writer *writer) const override {
+    writer->write_f64(amplitude_);
+    writer->write_u32(static_cast<uint32>(oscillators_.size()));
+    for (const auto &osc : oscillators_) {
+      writer->write_f64(osc.first);
+      writer->write_f64(osc.second);
+    }
+  }
+
+  bool restore_state(Checkpoint_reader *reader) override {
+    amplitude_ = reader->read_f64();
+    const uint32 count = reader->read_u32();
+    if (!reader->ok() || count == 0U ||
+        count > reader->remaining() / (2U * sizeof(double))) {
+      return false;
+    }
+    oscillators_.clear();
+    for (uint32 i = 0; i < count; ++i) {
+      const double freq = reader->read_f64();
+      const double phase = reader->read_f64();
+      oscillators_.push_back({freq, phase});
+    }
+    return reader->ok();
+  }
+
 private:
   std::vector<std::pair<double, double>> oscillators_; // {freq, phase}
   double amplitude_;
@@ -81,6 +181,11 @@ private:
  */
 class CompositeGenerator : public SignalGenerator {
 public:
+  CompositeGenerator() = default;
+  // The component list is allocated from `resource` (e.g. an Ecg_arena).
+  explicit CompositeGenerator(std::pmr::memory_resource *resource)
+      : components_(resource) {}
+
   void add(SignalGenerator *generator) { components_.push_back(generator); }
 
   double get_value(double time_s) override {
@@ -91,8 +196,48 @@ public:
     return total;
   }
 
+  // Each component fills the whole block in turn, so a source that advances
+  // once per sample for all leads (SpectralNoiseGenerator) keeps doing so.
+  void add_to_leads(const double *times_s, std::size_t count, double *leads,
+                    std::size_t lead_count, std::size_t lead_stride) override {
+    for (auto *gen : components_) {
+      gen->add_to_leads(times_s, count, leads, lead_count, lead_stride);
+    }
+  }
+
+  bool has_random_access() const override {
+    for (const auto *gen : components_) {
+      if (!gen->has_random_access()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void add_at_times(const double *times_s, std::size_t count, double *leads,
+                    std::size_t lead_count, std::size_t lead_stride) override {
+    for (auto *gen : components_) {
+      gen->add_at_times(times_s, count, leads, lead_count, lead_stride);
+    }
+  }
+
+  void save_state(Checkpoint_writer *writer) const override {
+    for (auto *gen : components_) {
+      gen->save_state(writer);
+    }
+  }
+
+  bool restore_state(Checkpoint_reader *reader) override {
+    for (auto *gen : components_) {
+      if (!gen->restore_state(reader)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
 private:
-  std::vector<SignalGenerator *> components_;
+  std::pmr::vector<SignalGenerator *> components_;
 };
 
 #endif // NOISE_GENERATOR_H
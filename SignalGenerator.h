@@ -2,6 +2,10 @@
 #define SIGNAL_GENERATOR_H
 
 #include <cmath>
+#include <cstddef>
+
+class Checkpoint_reader;
+class Checkpoint_writer;
 
 /**
  * @brief Abstract base class for any time-variant signal source.
@@ -20,6 +24,65 @@ public:
    * @return Amplitude (usually in millivolts).
    */
   virtual double get_value(double time_s) = 0;
+
+  /**
+   * @brief Add this source to a block of lead-major sample columns.
+   *
+   * The default implementation calls get_value() once per lead per sample,
+   * visiting samples in time order, so a stateful source consumes its
+   * sequence exactly as the per-sample engine path does.
+   *
+   * @param times_s Absolute time of each sample.
+   * @param count Number of samples in the block.
+   * @param leads Base of the lead columns; lead l starts at l * lead_stride.
+   * @param lead_count Number of lead columns.
+   * @param lead_stride Distance in elements between two lead columns.
+   */
+  virtual void add_to_leads(const double *times_s, std::size_t count,
+                            double *leads, std::size_t lead_count,
+                            std::size_t lead_stride) {
+    for (std::size_t i = 0; i < count; ++i) {
+      for (std::size_t lead = 0; lead < lead_count; ++lead) {
+        leads[(lead * lead_stride) + i] += get_value(times_s[i]);
+      }
+    }
+  }
+
+  /**
+   * @brief Whether add_at_times() is supported, i.e. the source's value at a
+   * time does not depend on which times were visited before.
+   */
+  virtual bool has_random_access() const { return false; }
+
+  /**
+   * @brief Add this source at arbitrary times, in any order, without
+   * advancing its streaming state.
+   *
+   * Only valid when has_random_access() is true. The default calls
+   * get_value() once per lead per time, which is correct for sources that
+   * are pure functions of time. Parameters are as for add_to_leads().
+   */
+  virtual void add_at_times(const double *times_s, std::size_t count,
+                            double *leads, std::size_t lead_count,
+                            std::size_t lead_stride) {
+    for (std::size_t i = 0; i < count; ++i) {
+      for (std::size_t lead = 0; lead < lead_count; ++lead) {
+        leads[(lead * lead_stride) + i] += get_value(times_s[i]);
+      }
+    }
+  }
+
+  /**
+   * @brief Serialize parameters and internal state for a checkpoint.
+   *
+   * Sources whose value is a pure function of time have nothing to save.
+   */
+  virtual void save_state(Checkpoint_writer * /*writer*/) const {}
+
+  /**
+   * @brief Restore what save_state() wrote; returns false on a bad record.
+   */
+  virtual bool restore_state(Checkpoint_reader * /*reader*/) { return true; }
 };
 
 #endif // SIGNAL_GENERATOR_H
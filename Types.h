@@ -1,12 +1,19 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include <cstdint>
+
 // Rule 209: The basic types of int, short, long, float and double shall not be used,
 // but specific-length equivalents should be typedef'd.
 typedef double float64;
 typedef float  float32;
 typedef int    int32;
+typedef std::int16_t  int16;
+typedef std::int64_t  int64;
+typedef std::uint8_t  uint8;
+typedef std::uint32_t uint32;
+typedef std::uint64_t uint64;
 typedef bool   boolean; // JSF often prefers explicit boolean type or just bool if allowed, but Rule 209 focuses on numeric.
                         // Rule 214 says "The bool type will be used for boolean values". So bool is fine.
 
-#endif // TYPES_H
\ No newline at end of file
+#endif // TYPES_H
@@ -1,15 +1,23 @@
+#include <array>
 #include <cmath>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <unistd.h>
 
+#include "ECGArchive.h"
+#include "ECGCheckpoint.h"
 #include "ECGMorphology.h"
+#include "ECGPipeline.h"
 #include "ECGSimulation.h"
+#include "ECGSpectralNoise.h"
 #include "NoiseGenerator.h"
 
 void print_usage(const char *prog_name) {
@@ -24,7 +32,32 @@ void print_usage(const char *prog_name) {
          "0.0)\n"
       << "  --mains <amp>     Add 60Hz mains hum with amplitude (default: "
          "0.0)\n"
-      << "  --out <file>      Output CSV file (default: ecg.csv)\n"
+      << "  --pink <rms>      Add 1/f (pink) noise with RMS in mV (default: 0.0)\n"
+      << "  --emg <rms>       Add bursty muscle (EMG) noise with RMS in mV\n"
+      << "  --motion <rms>    Add electrode motion artifacts with RMS in mV\n"
+      << "  --noise-correlation <r>  Lead-to-lead correlation of "
+         "pink/EMG/motion\n"
+      << "                    noise, 0 (independent) to 1 (default: 1.0)\n"
+      << "  --seed <n>        Seed for pink/EMG/motion noise (default: 1)\n"
+      << "  --leads <file>    Lead matrix file, one '<name> <x> <y> <z>' per "
+         "line\n"
+      << "                    (default: standard 12 leads)\n"
+      << "  --out <file>      Output file (default: ecg.csv)\n"
+      << "  --format <fmt>    Output format: csv, archive, or raw (ADC codes,\n"
+      << "                    interleaved, native byte order; needs --adc-bits)\n"
+      << "                    (default: csv)\n"
+      << "  --adc-bits <n>    Emulate an n-bit ADC (8-24) after noise "
+         "injection\n"
+      << "  --adc-lsb <uV>    ADC code size in microvolts (default: 2.5)\n"
+      << "  --adc-gain <g>    Analog gain ahead of the ADC (default: 1.0)\n"
+      << "  --dither          Add seeded +/-1 LSB triangular dither\n"
+      << "  --chunk <n>       Samples per archive chunk (default: 4096)\n"
+      << "  --block <n>       Samples per pipeline block (default: 4096)\n"
+      << "  --checkpoint <file>       Write resumable checkpoints to file\n"
+      << "  --checkpoint-every <sec>  Simulated seconds between checkpoints "
+         "(default: 600)\n"
+      << "  --resume <file>   Continue an interrupted run from a checkpoint\n"
+      << "                    (pass the same options as the original run)\n"
       << "  --help            Show this help\n";
 }
 
@@ -36,7 +69,23 @@ int main(int argc, char *argv[]) {
   float64 white_noise_amp = 0.0;
   float64 wander_amp = 0.0;
   float64 mains_amp = 0.0;
+  float64 pink_rms = 0.0;
+  float64 emg_rms = 0.0;
+  float64 motion_rms = 0.0;
+  float64 noise_correlation = 1.0;
+  uint64 noise_seed = 1U;
   std::string output_file = "ecg.csv";
+  std::string output_format = "csv";
+  std::size_t archive_chunk_samples = 4096U;
+  Pipeline_config pipeline_config;
+  std::string checkpoint_file;
+  float64 checkpoint_every_s = 600.0;
+  std::string resume_file;
+  std::string lead_matrix_file;
+  int32 adc_bits = 0;
+  float64 adc_lsb_uv = 2.5;
+  float64 adc_gain = 1.0;
+  bool adc_dither = false;
 
   // Parse arguments
   for (int i = 1; i < argc; ++i) {
@@ -55,8 +104,43 @@ int main(int argc, char *argv[]) {
       wander_amp = std::stod(argv[++i]);
     } else if (std::strcmp(argv[i], "--mains") == 0 && i + 1 < argc) {
       mains_amp = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--pink") == 0 && i + 1 < argc) {
+      pink_rms = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--emg") == 0 && i + 1 < argc) {
+      emg_rms = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--motion") == 0 && i + 1 < argc) {
+      motion_rms = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--noise-correlation") == 0 &&
+               i + 1 < argc) {
+      noise_correlation = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      noise_seed = static_cast<uint64>(std::stoull(argv[++i]));
+    } else if (std::strcmp(argv[i], "--adc-bits") == 0 && i + 1 < argc) {
+      adc_bits = std::stoi(argv[++i]);
+    } else if (std::strcmp(argv[i], "--adc-lsb") == 0 && i + 1 < argc) {
+      adc_lsb_uv = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--adc-gain") == 0 && i + 1 < argc) {
+      adc_gain = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--dither") == 0) {
+      adc_dither = true;
+    } else if (std::strcmp(argv[i], "--leads") == 0 && i + 1 < argc) {
+      lead_matrix_file = argv[++i];
     } else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
       output_file = argv[++i];
+    } else if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+      output_format = argv[++i];
+    } else if (std::strcmp(argv[i], "--chunk") == 0 && i + 1 < argc) {
+      archive_chunk_samples = static_cast<std::size_t>(std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--block") == 0 && i + 1 < argc) {
+      pipeline_config.block_samples =
+          static_cast<std::size_t>(std::stoul(argv[++i]));
+    } else if (std::strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+      checkpoint_file = argv[++i];
+    } else if (std::strcmp(argv[i], "--checkpoint-every") == 0 &&
+               i + 1 < argc) {
+      checkpoint_every_s = std::stod(argv[++i]);
+    } else if (std::strcmp(argv[i], "--resume") == 0 && i + 1 < argc) {
+      resume_file = argv[++i];
     } else {
       std::cerr << "Unknown or incomplete option: " << argv[i] << "\n";
       print_usage(argv[0]);
@@ -86,6 +170,35 @@ int main(int argc, char *argv[]) {
   // 2. Setup Engine
   ECGSimulationEngine engine(morphology, heart_rate_bpm, sampling_rate_hz);
 
+  if (!lead_matrix_file.empty()) {
+    Lead_matrix lead_matrix;
+    if (!lead_matrix.load(lead_matrix_file)) {
+      std::cerr << "Failed to read lead matrix: " << lead_matrix_file << "\n";
+      return 1;
+    }
+    std::cout << "  Leads: " << lead_matrix.lead_count() << " from "
+              << lead_matrix_file << "\n";
+    engine.set_lead_matrix(lead_matrix);
+  }
+
+  if (adc_bits != 0) {
+    Adc_config adc_config;
+    adc_config.resolution_bits = adc_bits;
+    adc_config.lsb_mv = adc_lsb_uv / 1000.0;
+    adc_config.lead_gain.assign(engine.lead_count(), adc_gain);
+    adc_config.dither = adc_dither;
+    if (!engine.set_adc(adc_config)) {
+      std::cerr << "Unsupported ADC configuration\n";
+      return 1;
+    }
+    std::cout << "  ADC: " << adc_bits << " bit, " << adc_lsb_uv
+              << " uV/LSB\n";
+  }
+  if ((output_format == "raw") != engine.has_adc()) {
+    std::cerr << "--format raw and --adc-bits must be used together\n";
+    return 1;
+  }
+
   // 3. Add Noise
   if (std::abs(white_noise_amp) > 1e-9) {
     std::cout << "  Adding White Noise (amp=" << white_noise_amp << ")\n";
@@ -102,32 +215,197 @@ int main(int argc, char *argv[]) {
     engine.add_noise_source(std::make_shared<MainsHumGenerator>(mains_amp));
   }
 
-  // 4. Generate
-  const std::vector<Lead_sample> samples = engine.generate(duration_seconds);
+  // Spectral sources: one channel per lead, each source with its own seed.
+  const std::array<std::pair<const char *, Spectral_noise_config>, 3>
+      spectral_sources = {{
+          {"1/f Noise", create_colored_noise_config(1.0, pink_rms)},
+          {"EMG Noise", create_emg_noise_config(emg_rms)},
+          {"Motion Artifacts", create_motion_artifact_config(motion_rms)},
+      }};
+  for (std::size_t s = 0; s < spectral_sources.size(); ++s) {
+    Spectral_noise_config config = spectral_sources[s].second;
+    if (std::abs(config.rms_mv) <= 1e-9) {
+      continue;
+    }
+    config.seed = noise_seed + s;
+    config.correlation = noise_correlation;
+    std::cout << "  Adding " << spectral_sources[s].first
+              << " (rms=" << config.rms_mv << ")\n";
+    engine.add_noise_source(std::make_shared<SpectralNoiseGenerator>(
+        config, sampling_rate_hz, engine.lead_count()));
+  }
+
+  // 4. Resume from a checkpoint if requested. The checkpoint holds the
+  // engine state followed by the output writer's state.
+  const uint32 output_tag = (output_format == "archive") ? 1U
+                            : (output_format == "raw")   ? 2U
+                                                         : 0U;
+  std::vector<uint8> resume_data;
+  Checkpoint_reader resume_reader(nullptr, 0U);
+  if (!resume_file.empty()) {
+    if (!load_checkpoint_file(resume_file, &resume_data)) {
+      std::cerr << "Failed to read checkpoint: " << resume_file << "\n";
+      return 1;
+    }
+    resume_reader = Checkpoint_reader(resume_data.data(), resume_data.size());
+    if (resume_reader.read_u32() != output_tag ||
+        !engine.restore_state(&resume_reader)) {
+      std::cerr << "Checkpoint does not match this configuration: "
+                << resume_file << "\n";
+      return 1;
+    }
+    std::cout << "  Resuming at sample " << engine.next_sample_index()
+              << "\n";
+  }
+  const bool resuming = !resume_file.empty();
+
+  // 5. Open output and set up the encoding/writing stage. The sink runs
+  // concurrently with rendering and noise in the stage pipeline.
+  std::ofstream stream_output;
+  Archive_writer archive_output;
+  ECGPipeline::Block_stage sink;
+  // Flushes the output and appends its resume state to a checkpoint.
+  std::function<bool(Checkpoint_writer *)> save_output_state;
+
+  if (output_format == "archive") {
+    const bool opened =
+        resuming ? archive_output.resume(output_file, &resume_reader)
+                 : archive_output.open(output_file, engine.lead_count(),
+                                       sampling_rate_hz,
+                                       archive_chunk_samples, true);
+    if (!opened) {
+      std::cerr << "Failed to open output file: " << output_file << "\n";
+      return 1;
+    }
+    sink = [&archive_output](Sample_block *block) {
+      return archive_output.append(block);
+    };
+    save_output_state = [&archive_output](Checkpoint_writer *writer) {
+      return archive_output.save_state(writer);
+    };
+  } else if (output_format == "csv" || output_format == "raw") {
+    const std::ios::openmode binary_mode =
+        (output_format == "raw") ? std::ios::binary : std::ios::openmode();
+    if (resuming) {
+      const uint64 offset = resume_reader.read_u64();
+      if (!resume_reader.ok() ||
+          ::truncate(output_file.c_str(), static_cast<off_t>(offset)) != 0) {
+        std::cerr << "Failed to truncate output file: " << output_file
+                  << "\n";
+        return 1;
+      }
+      stream_output.open(output_file,
+                         std::ios::in | std::ios::out | binary_mode);
+      stream_output.seekp(static_cast<std::streamoff>(offset));
+    } else {
+      stream_output.open(output_file, std::ios::out | binary_mode);
+    }
+    if (!stream_output.is_open()) {
+      std::cerr << "Failed to open output file: " << output_file << "\n";
+      return 1;
+    }
+
+    if (!resuming && output_format == "csv") {
+      stream_output << "time";
+      for (std::size_t lead = 0; lead < engine.lead_count(); ++lead) {
+        stream_output << ',' << engine.lead_matrix().name(lead);
+      }
+      stream_output << '\n';
+    }
+    stream_output << std::fixed << std::setprecision(6);
+
+    if (output_format == "raw") {
+      // Device-style frames: one code per lead per sample, interleaved.
+      std::vector<char> frame_buffer;
+      sink = [&stream_output, frame_buffer](Sample_block *block) mutable {
+        const Adc_block &adc = block->adc;
+        const bool narrow = adc_uses_int16(adc.resolution_bits);
+        const std::size_t code_bytes = narrow ? sizeof(int16) : sizeof(int32);
+        frame_buffer.resize(adc.count * adc.lead_count * code_bytes);
+        char *out = frame_buffer.data();
+        for (std::size_t i = 0; i < adc.count; ++i) {
+          for (std::size_t lead = 0; lead < adc.lead_count; ++lead) {
+            const std::size_t at = (lead * adc.capacity) + i;
+            if (narrow) {
+              std::memcpy(out, &adc.codes16[at], code_bytes);
+            } else {
+              std::memcpy(out, &adc.codes32[at], code_bytes);
+            }
+            out += code_bytes;
+          }
+        }
+        stream_output.write(frame_buffer.data(),
+                            static_cast<std::streamsize>(frame_buffer.size()));
+        return stream_output.good();
+      };
+    } else {
+      sink = [&stream_output](Sample_block *block) {
+        for (std::size_t i = 0; i < block->count; ++i) {
+          stream_output << block->time_s[i];
+          for (std::size_t lead = 0; lead < block->lead_count; ++lead) {
+            stream_output << ',' << lead_column(block, lead)[i];
+          }
+          stream_output << '\n';
+        }
+        return stream_output.good();
+      };
+    }
+    save_output_state = [&stream_output](Checkpoint_writer *writer) {
+      stream_output.flush();
+      writer->write_u64(static_cast<uint64>(stream_output.tellp()));
+      return stream_output.good();
+    };
+  } else {
+    std::cerr << "Unknown output format: " << output_format << "\n";
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  if (!checkpoint_file.empty()) {
+    const float64 interval_blocks =
+        std::ceil((checkpoint_every_s * sampling_rate_hz) /
+                  static_cast<float64>(pipeline_config.block_samples));
+    pipeline_config.checkpoint_interval_blocks =
+        (interval_blocks >= 1.0) ? static_cast<std::size_t>(interval_blocks)
+                                 : 1U;
+  }
+
+  ECGPipeline pipeline(&engine, pipeline_config);
+  pipeline.set_sink(sink);
+
+  std::vector<uint8> checkpoint_data;
+  if (!checkpoint_file.empty()) {
+    pipeline.set_checkpoint_handler(
+        [&](const std::vector<uint8> &engine_state) {
+          Checkpoint_writer writer(&checkpoint_data);
+          writer.write_u32(output_tag);
+          writer.write_bytes(engine_state.data(), engine_state.size());
+          return save_output_state(&writer) &&
+                 save_checkpoint_file(checkpoint_file, checkpoint_data);
+        });
+  }
 
-  // 5. Output
-  std::ofstream csv_output(output_file);
-  if (!csv_output.is_open()) {
-    std::cerr << "Failed to open output file: " << output_file << "\n";
+  // 6. Generate and write
+  const uint64 end_sample = engine.sample_count(duration_seconds);
+  const uint64 total_samples = (end_sample > engine.next_sample_index())
+                                   ? end_sample - engine.next_sample_index()
+                                   : 0U;
+  const bool run_ok = pipeline.run(total_samples);
+  const bool close_ok =
+      (output_format == "archive") ? archive_output.close() : true;
+  if (!run_ok || !close_ok) {
+    std::cerr << "Failed to write output file: " << output_file << "\n";
     return 1;
   }
 
-  csv_output << "time,lead_I,lead_II,lead_III,aVR,aVL,aVF,V1,V2,V3,V4,V5,V6\n";
-  csv_output << std::fixed << std::setprecision(6);
-
-  for (const auto &sample : samples) {
-    csv_output << sample.time_s << ',' << sample.leads[lead_i_index] << ','
-               << sample.leads[lead_ii_index] << ','
-               << sample.leads[lead_iii_index] << ','
-               << sample.leads[lead_avr_index] << ','
-               << sample.leads[lead_avl_index] << ','
-               << sample.leads[lead_avf_index] << ','
-               << sample.leads[lead_v1_index] << ','
-               << sample.leads[lead_v2_index] << ','
-               << sample.leads[lead_v3_index] << ','
-               << sample.leads[lead_v4_index] << ','
-               << sample.leads[lead_v5_index] << ','
-               << sample.leads[lead_v6_index] << '\n';
+  // 7. Report where the time went; the busiest stage bounds throughput.
+  std::cout << "Pipeline stage utilization (wall "
+            << pipeline.stats().front().wall_s << " s):\n";
+  for (const auto &stat : pipeline.stats()) {
+    std::cout << "  " << std::setw(8) << std::left << stat.name << std::right
+              << std::setw(7) << std::setprecision(1) << std::fixed
+              << (stat.utilization() * 100.0) << " %  (" << stat.blocks
+              << " blocks, " << stat.samples << " samples)\n";
   }
 
   std::cout << "Simulation complete. Data written to " << output_file << "\n";